@@ -0,0 +1,488 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "dmut.h"
+
+
+/*
+ *	dmut_bench, measures dmut against std::shared_mutex and std::mutex.
+ *
+ *	every case runs its threads for a fixed duration and counts the operations
+ *	they completed, a case is reported as the time an operation takes a single
+ *	thread (ns_per_op) and the throughput of all the threads together (ops_per_sec).
+ *
+ *	usage: dmut_bench [--format=table|csv|json] [--threads=N] [--duration-ms=N] [--filter=TEXT]
+ *
+ *	*	format		the output format, csv and json are meant to be tracked across releases.
+ *	*	threads		the most threads a case uses, by default the number of cores (at least 2).
+ *	*	duration-ms	how long every case runs for, 200 by default.
+ *	*	filter		only runs the suites whose name contains the text.
+ */
+
+struct options
+{
+	enum { TABLE, CSV, JSON } format = TABLE;
+	unsigned threads = std::max(2u, std::thread::hardware_concurrency());
+	std::chrono::milliseconds duration{200};
+	std::string filter;
+};
+
+struct result
+{
+	std::string suite;
+	std::string subject;
+	unsigned threads;
+	std::string param;
+	double ns_per_op;
+	double ops_per_sec;
+};
+
+static options config;
+static std::vector<result> results;
+
+/*
+ *	Subjects, the same counter guarded by every kind of lock being compared.
+ *	reading and writing run a dependent computation of a given length
+ *	inside the critical section, 0 leaves only the lock itself.
+ */
+
+// the values read are stored here so reading cannot be optimized away.
+static std::atomic<long> sink(0);
+
+static void keep(const long value) noexcept { sink.store(value, std::memory_order_relaxed); }
+
+static long spin(long value, const unsigned work) noexcept
+{
+	for (unsigned i = 0; i < work; ++i) value = value * 31 + i;
+	return value;
+}
+
+template <typename Lock>
+struct dmut_subject
+{
+	dmut<long, Lock> value{0L};
+
+	long read(const unsigned work) { return spin(*this->value.peek(), work); }
+
+	void write(const unsigned work)
+	{
+		auto lock = this->value.lock();
+		*lock = spin(*lock, work) + 1;
+	}
+
+	bool write_if(const long parity)
+	{
+		auto lock = this->value.lock();
+		if ((*lock & 1) != parity) return false;
+
+		++*lock;
+		return true;
+	}
+};
+
+struct shared_mutex_subject
+{
+	std::shared_mutex mutex;
+	long value = 0;
+
+	long read(const unsigned work)
+	{
+		std::shared_lock<std::shared_mutex> lock(this->mutex);
+		return spin(this->value, work);
+	}
+
+	void write(const unsigned work)
+	{
+		std::lock_guard<std::shared_mutex> lock(this->mutex);
+		this->value = spin(this->value, work) + 1;
+	}
+
+	bool write_if(const long parity)
+	{
+		std::lock_guard<std::shared_mutex> lock(this->mutex);
+		if ((this->value & 1) != parity) return false;
+
+		++this->value;
+		return true;
+	}
+};
+
+// readers exclude each other as well.
+struct mutex_subject
+{
+	std::mutex mutex;
+	long value = 0;
+
+	long read(const unsigned work)
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		return spin(this->value, work);
+	}
+
+	void write(const unsigned work)
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->value = spin(this->value, work) + 1;
+	}
+
+	bool write_if(const long parity)
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		if ((this->value & 1) != parity) return false;
+
+		++this->value;
+		return true;
+	}
+};
+
+template <typename F>
+void for_each_subject(F&& fn)
+{
+	fn.template operator()<dmut_subject<reader_preferring_lock>>("dmut");
+	fn.template operator()<dmut_subject<writer_preferring_lock>>("dmut_writer_preferring");
+	fn.template operator()<dmut_subject<phase_fair_lock>>("dmut_phase_fair");
+	fn.template operator()<dmut_subject<big_reader_lock<>>>("brdmut");
+	fn.template operator()<dmut_subject<cohort_lock<>>>("dmut_cohort");
+	fn.template operator()<shared_mutex_subject>("std::shared_mutex");
+	fn.template operator()<mutex_subject>("std::mutex");
+}
+
+/*
+ *	Running cases, the threads start together, run the body until the duration
+ *	passes and report the number of operations they did.
+ */
+
+// xorshift, cheap enough not to show up next to the locks.
+struct random_bits
+{
+	std::uint64_t state;
+
+	explicit random_bits(const std::uint64_t seed) : state(seed * 0x9E3779B97F4A7C15ull + 1) {}
+
+	std::uint64_t next() noexcept
+	{
+		this->state ^= this->state << 13;
+		this->state ^= this->state >> 7;
+		this->state ^= this->state << 17;
+		return this->state;
+	}
+};
+
+// the number of operations done between checks of the stop flag.
+static constexpr unsigned BATCH = 64;
+
+/**
+ * \param body called with the index of the thread, returns the number of operations done.
+ */
+template <typename F>
+void run_case(const char *suite, const char *subject, const unsigned threads, const std::string& param, F&& body)
+{
+	std::atomic<unsigned> ready(0);
+	std::atomic<bool> go(false), stop(false);
+	std::atomic<std::uint64_t> total(0);
+
+	std::vector<std::thread> workers;
+	for (unsigned i = 0; i < threads; ++i)
+	{
+		workers.emplace_back([&, i]
+		{
+			ready.fetch_add(1);
+			while (!go.load()) std::this_thread::yield();
+
+			std::uint64_t ops = 0;
+			while (!stop.load(std::memory_order_relaxed)) ops += body(i);
+			total.fetch_add(ops);
+		});
+	}
+
+	while (ready.load() != threads) std::this_thread::yield();
+
+	const auto start = std::chrono::steady_clock::now();
+	go.store(true);
+	std::this_thread::sleep_for(config.duration);
+	stop.store(true);
+
+	for (std::thread& worker : workers) worker.join();
+
+	const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+	const double ops = double(std::max<std::uint64_t>(total.load(), 1));
+
+	results.push_back(result{ suite, subject, threads, param, elapsed.count() * threads / ops, ops * 1e9 / elapsed.count() });
+}
+
+static std::vector<unsigned> thread_counts()
+{
+	std::vector<unsigned> counts;
+	for (unsigned n = 1; n < config.threads; n *= 2) counts.push_back(n);
+	counts.push_back(config.threads);
+	return counts;
+}
+
+static bool selected(const char *suite) { return std::strstr(suite, config.filter.c_str()) != nullptr; }
+
+/*
+ *	Suites.
+ */
+
+// a single thread acquiring and releasing a free lock.
+static void bench_uncontended()
+{
+	for_each_subject([]<typename S>(const char *name)
+	{
+		S subject;
+		run_case("uncontended", name, 1, "write", [&subject](unsigned)
+		{
+			for (unsigned k = 0; k < BATCH; ++k) subject.write(0);
+			return BATCH;
+		});
+
+		run_case("uncontended", name, 1, "read", [&subject](unsigned)
+		{
+			long sum = 0;
+			for (unsigned k = 0; k < BATCH; ++k) sum += subject.read(0);
+			keep(sum);
+			return BATCH;
+		});
+	});
+}
+
+// only readers, from one thread up to all of them.
+static void bench_read_scaling()
+{
+	for_each_subject([]<typename S>(const char *name)
+	{
+		for (const unsigned threads : thread_counts())
+		{
+			S subject;
+			run_case("read_scaling", name, threads, "", [&subject](unsigned)
+			{
+				long sum = 0;
+				for (unsigned k = 0; k < BATCH; ++k) sum += subject.read(0);
+				keep(sum);
+				return BATCH;
+			});
+		}
+	});
+}
+
+// every thread reads or writes at random, with a fixed share of reads.
+static void bench_mixed()
+{
+	for (const unsigned reads : { 99u, 90u, 50u })
+	{
+		const std::string param = "read_" + std::to_string(reads) + "_write_" + std::to_string(100 - reads);
+
+		for_each_subject([&]<typename S>(const char *name)
+		{
+			S subject;
+			std::vector<random_bits> bits;
+			for (unsigned i = 0; i < config.threads; ++i) bits.emplace_back(i);
+
+			run_case("mixed", name, config.threads, param, [&](const unsigned thread)
+			{
+				for (unsigned k = 0; k < BATCH; ++k)
+				{
+					if (bits[thread].next() % 100 < reads) subject.read(0);
+					else subject.write(0);
+				}
+
+				return BATCH;
+			});
+		});
+	}
+}
+
+// every thread writes, sweeping the length of the critical section.
+static void bench_critical_section()
+{
+	for (const unsigned work : { 0u, 16u, 64u, 256u, 1024u })
+	{
+		for_each_subject([&]<typename S>(const char *name)
+		{
+			S subject;
+			run_case("critical_section", name, config.threads, "work_" + std::to_string(work), [&](unsigned)
+			{
+				for (unsigned k = 0; k < BATCH; ++k) subject.write(work);
+				return BATCH;
+			});
+		});
+	}
+}
+
+// two threads take turns writing, every operation is a handoff of the lock with the data.
+static void bench_handoff()
+{
+	for_each_subject([]<typename S>(const char *name)
+	{
+		S subject;
+		run_case("handoff", name, 2, "", [&subject](const unsigned thread)
+		{
+			std::uint64_t handoffs = 0;
+			for (unsigned k = 0; k < BATCH; ++k) handoffs += subject.write_if(thread);
+			return handoffs;
+		});
+	});
+}
+
+/*
+ *	Striped usage, every thread repeatedly writes to its own element of a vector
+ *	of mutexes, the threads never contend on the same lock, so any slowdown
+ *	compared to a single thread comes from elements sharing cache lines.
+ */
+
+// the layout of a dmut before the lock state was aligned, the stripes are packed.
+struct packed_stripe
+{
+	reader_preferring_lock lock_state;
+	int value = 0;
+
+	void write()
+	{
+		std::lock_guard<reader_preferring_lock> guard(this->lock_state);
+		++this->value;
+	}
+};
+
+template <typename Layout>
+struct dmut_stripe
+{
+	dmut<int, reader_preferring_lock, inline_storage<Layout>> value{0};
+
+	void write() { ++*this->value.lock(); }
+};
+
+template <typename Stripe>
+void run_striped(const char *name, const unsigned threads)
+{
+	std::vector<Stripe> stripes(threads);
+	run_case("layout", name, threads, "", [&stripes](const unsigned thread)
+	{
+		for (unsigned k = 0; k < BATCH; ++k) stripes[thread].write();
+		return BATCH;
+	});
+}
+
+static void bench_layout()
+{
+	for (const unsigned threads : thread_counts())
+	{
+		run_striped<packed_stripe>("packed", threads);
+		run_striped<dmut_stripe<same_line_layout>>("same_line_layout", threads);
+		run_striped<dmut_stripe<separate_line_layout>>("separate_line_layout", threads);
+	}
+}
+
+/*
+ *	Contended usage, every thread repeatedly increments a single shared counter,
+ *	either by locking it or by submitting the increment to the lock holder.
+ */
+
+static void bench_counter()
+{
+	for (const unsigned threads : thread_counts())
+	{
+		dmut<long> locked(0L), submitted(0L);
+		run_case("counter", "lock", threads, "", [&locked](unsigned)
+		{
+			for (unsigned k = 0; k < BATCH; ++k) ++*locked.lock();
+			return BATCH;
+		});
+
+		run_case("counter", "submit", threads, "", [&submitted](unsigned)
+		{
+			for (unsigned k = 0; k < BATCH; ++k) submitted.submit([](long& value) { ++value; });
+			return BATCH;
+		});
+	}
+}
+
+/*
+ *	Output.
+ */
+
+static void print_table()
+{
+	std::printf("%-18s %-24s %8s %-22s %12s %16s\n", "suite", "subject", "threads", "param", "ns/op", "ops/s");
+	for (const result& r : results)
+	{
+		std::printf("%-18s %-24s %8u %-22s %12.2f %16.0f\n", r.suite.c_str(), r.subject.c_str(), r.threads,
+			r.param.c_str(), r.ns_per_op, r.ops_per_sec);
+	}
+}
+
+static void print_csv()
+{
+	std::printf("suite,subject,threads,param,ns_per_op,ops_per_sec\n");
+	for (const result& r : results)
+	{
+		std::printf("%s,%s,%u,%s,%.3f,%.0f\n", r.suite.c_str(), r.subject.c_str(), r.threads,
+			r.param.c_str(), r.ns_per_op, r.ops_per_sec);
+	}
+}
+
+static void print_json()
+{
+	std::printf("{\n  \"context\": { \"cores\": %u, \"threads\": %u, \"duration_ms\": %lld },\n  \"benchmarks\": [",
+		std::thread::hardware_concurrency(), config.threads, static_cast<long long>(config.duration.count()));
+
+	// none of the names need escaping.
+	for (std::size_t i = 0; i < results.size(); ++i)
+	{
+		const result& r = results[i];
+		std::printf("%s\n    { \"suite\": \"%s\", \"subject\": \"%s\", \"threads\": %u, \"param\": \"%s\", \"ns_per_op\": %.3f, \"ops_per_sec\": %.0f }",
+			i == 0 ? "" : ",", r.suite.c_str(), r.subject.c_str(), r.threads, r.param.c_str(), r.ns_per_op, r.ops_per_sec);
+	}
+
+	std::printf("\n  ]\n}\n");
+}
+
+static bool parse_options(const int argc, char **argv)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		const char *arg = argv[i];
+		if (std::strcmp(arg, "--format=table") == 0) config.format = options::TABLE;
+		else if (std::strcmp(arg, "--format=csv") == 0) config.format = options::CSV;
+		else if (std::strcmp(arg, "--format=json") == 0) config.format = options::JSON;
+		else if (std::strncmp(arg, "--threads=", 10) == 0) config.threads = std::max(1, std::atoi(arg + 10));
+		else if (std::strncmp(arg, "--duration-ms=", 14) == 0) config.duration = std::chrono::milliseconds(std::max(1, std::atoi(arg + 14)));
+		else if (std::strncmp(arg, "--filter=", 9) == 0) config.filter = arg + 9;
+		else
+		{
+			std::fprintf(stderr, "unknown option %s\n"
+				"usage: dmut_bench [--format=table|csv|json] [--threads=N] [--duration-ms=N] [--filter=TEXT]\n", arg);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	if (!parse_options(argc, argv)) return 1;
+
+	if (selected("uncontended")) bench_uncontended();
+	if (selected("read_scaling")) bench_read_scaling();
+	if (selected("mixed")) bench_mixed();
+	if (selected("critical_section")) bench_critical_section();
+	if (selected("handoff")) bench_handoff();
+	if (selected("layout")) bench_layout();
+	if (selected("counter")) bench_counter();
+
+	if (config.format == options::CSV) print_csv();
+	else if (config.format == options::JSON) print_json();
+	else print_table();
+
+	return 0;
+}
@@ -1,284 +1,4814 @@
 #ifndef DMUT_H
 #define DMUT_H
 
+#include <algorithm>
+#include <array>
 #include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <iterator>
 #include <memory>
 #include <mutex>
+#include <new>
 #include <optional>
+#include <ostream>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
-enum LOCK_TYPE { WRITER_LOCK, READER_LOCK, NO_LOCK };
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#include <immintrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 
-template <typename T>
-class dlock;
+#if defined(__linux__)
+#include <cerrno>
+#include <climits>
+#include <linux/futex.h>
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+#include <condition_variable>
+#endif
 
+enum LOCK_TYPE { WRITER_LOCK, READER_LOCK, UPGRADE_LOCK, NO_LOCK };
 
-/**
- * \brief	Data Oriented Mutex, The mutex holds the data and ensures
- *			mutual exclusion in accessing it as apposed to std::mutex
- *			which ensures mutual exclusion of code segments.
- *			this mutex behaves more like a std::shared_mutex since
- *			a readers lock (shared lock) can be acquired as well as
- *			a writers lock (exclusive lock).
+template <bool PREFER_WRITERS, std::uint32_t SPIN_BUDGET = 4096>
+class lock_word;
+
+typedef lock_word<false> reader_preferring_lock;
+typedef lock_word<true> writer_preferring_lock;
+
+/*
+ *	Layouts of a dmut, the lock state of a dmut always starts a cache line
+ *	of its own, so neighbouring dmuts (in an array for example) never share
+ *	a line, the layout decides whether the guarded data shares that line.
  *
- *			*	to acquire a writers lock use the lock() method,
- *				use try_lock() if you wish for the method to return
- *				upon failure.
+ *	*	same_line_layout - the data follows the lock state, a tiny T is fetched
+ *		along with the lock, at the cost of readers and writers of the data
+ *		contending with threads spinning on the lock.
  *
- *			*	to acquire a readers lock use the peek() method,
- *				use try_peek() if you wish for the method to return
- *				upon failure.
+ *	*	separate_line_layout - the data starts a cache line of its own,
+ *		accessing the data never disturbs threads waiting for the lock.
  *
- *			both operations return a dlock objects which acts as a unique_ptr
- *			to the data, once the dlock is destroyed
- *			(by going out of scope or using the unlock() method)
- *			the lock is released and can be acquired by others.
+ *	*	default_layout - same_line_layout if the data fits in the line of
+ *		the lock state, separate_line_layout otherwise.
+ */
+struct same_line_layout {};
+struct separate_line_layout {};
+struct default_layout {};
+
+/*
+ *	Storage policies of a dmut, decide where the guarded data lives.
  *
- *			notes:
+ *	*	inline_storage - the data is stored inside the dmut itself, placed
+ *		according to Layout, accessing the data costs no extra indirection.
  *
- *			*	it is recommended to use the make_dmut and new_dmut functions
- *				in order to construct a dmut, but the constructors are available
- *				and are better to use when for example the data the mutex should
- *				protect has already been constructed.
- *				
- *			*	creating a dmut with type T[] is impossible, this is both a pain
- *				to implement and should probably not be used, if you wish to create
- *				a mutex that protects an array that is not dynamically allocated then
- *				use std::array or some other safe wrapper.
- *			
- * \tparam T The type of data that the mutex guards.
+ *	*	pointer_storage - the dmut owns a pointer to data allocated on the
+ *		heap (see new_dmut) and deletes it once the dmut is destroyed,
+ *		the dmut can then guard data which cannot be moved into it,
+ *		and the whole data can be replaced without waiting for readers (see dmut::publish).
+ *
+ *	*	allocated_storage - the data is allocated through Allocator (see allocate_dmut),
+ *		so it can come from an arena or a memory resource, if the data itself
+ *		uses an allocator it is constructed with a copy of the dmut's allocator.
  */
-template <typename T>
-class dmut
+template <typename Layout = default_layout>
+struct inline_storage {};
+struct pointer_storage {};
+template <typename Allocator = std::allocator<std::byte>>
+struct allocated_storage {};
+
+template <typename T, typename Lock = reader_preferring_lock, typename Storage = inline_storage<>>
+class dmut;
+
+template <typename T, typename M = dmut<typename std::remove_const<T>::type>,
+	LOCK_TYPE TYPE = std::is_const<T>::value ? READER_LOCK : WRITER_LOCK>
+class dlock;
+
+
+namespace dmut_detail
 {
+	/*
+	 *	the size of a cache line, std::hardware_destructive_interference_size
+	 *	may vary between compiler versions and tuning flags which would give
+	 *	dmuts a different layout in translation units built with different flags,
+	 *	so the common line size is fixed instead.
+	 */
+	inline constexpr std::size_t CACHE_LINE = 64;
+
+	typedef std::chrono::steady_clock::time_point deadline;
+
+	/**
+	 * \brief	converts a time point of any clock to a deadline on the steady clock.
+	 */
+	template <typename Clock, typename Duration>
+	deadline to_deadline(const std::chrono::time_point<Clock, Duration>& until)
+	{
+		if constexpr (std::is_same<Clock, std::chrono::steady_clock>::value)
+			return std::chrono::time_point_cast<deadline::duration>(until);
+		else
+			return std::chrono::steady_clock::now() + std::chrono::ceil<deadline::duration>(until - Clock::now());
+	}
+
+	/*
+	 *	Parking, a thread waits on a word for as long as it holds some value
+	 *	and is woken up by a thread that changed the value.
+	 *	on linux the futex of the word is used directly, since it supports
+	 *	waiting with a timeout which std::atomic::wait does not.
+	 *	anywhere else every word is hashed to a bucket holding a mutex and
+	 *	a condition variable, the waiter checks the word while holding the
+	 *	bucket's mutex and the waker takes the mutex after changing the word,
+	 *	so a wake up can never be missed.
+	 */
+
+	static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t), "words must be usable as futexes");
+
+#if defined(__linux__)
+
+	inline long futex(std::atomic<std::uint32_t>& word, const int op, const std::uint32_t value, const timespec *timeout) noexcept
+	{
+		return syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), op, value, timeout, nullptr, FUTEX_BITSET_MATCH_ANY);
+	}
+
+	/**
+	 * \brief	blocks the calling thread as long as word holds the value s.
+	 *			the function might return spuriously.
+	 * \param	until the deadline for the wait or null for no deadline.
+	 * \return	false if the deadline has passed.
+	 */
+	inline bool wait(std::atomic<std::uint32_t>& word, const std::uint32_t s, const deadline *until = nullptr) noexcept
+	{
+		if (until == nullptr) 
+		{
+			futex(word, FUTEX_WAIT_BITSET_PRIVATE, s, nullptr);
+			return true;
+		}
+
+		// the bitset wait takes an absolute timeout on the monotonic clock,
+		// which is the clock behind std::chrono::steady_clock.
+		const auto since_epoch = until->time_since_epoch();
+		if (since_epoch.count() < 0) return false;
+		
+		const auto seconds = std::chrono::duration_cast<std::chrono::seconds>(since_epoch);
+		timespec timeout;
+		timeout.tv_sec = static_cast<time_t>(seconds.count());
+		timeout.tv_nsec = static_cast<long>(std::chrono::duration_cast<std::chrono::nanoseconds>(since_epoch - seconds).count());
+
+		return !(futex(word, FUTEX_WAIT_BITSET_PRIVATE, s, &timeout) == -1 && errno == ETIMEDOUT);
+	}
+
+	inline void wake_one(std::atomic<std::uint32_t>& word) noexcept { futex(word, FUTEX_WAKE_PRIVATE, 1, nullptr); }
+	inline void wake_all(std::atomic<std::uint32_t>& word) noexcept { futex(word, FUTEX_WAKE_PRIVATE, INT_MAX, nullptr); }
+
+#else
+
+	struct parking_bucket
+	{
+		std::mutex mutex;
+		std::condition_variable parked;
+	};
+
+	inline parking_bucket& bucket_of(const std::atomic<std::uint32_t>& word) noexcept
+	{
+		static parking_bucket buckets[64];
+		return buckets[(reinterpret_cast<std::uintptr_t>(&word) / sizeof(word)) % 64];
+	}
+
+	inline bool wait(std::atomic<std::uint32_t>& word, const std::uint32_t s, const deadline *until = nullptr) noexcept
+	{
+		parking_bucket& bucket = bucket_of(word);
+		std::unique_lock<std::mutex> guard(bucket.mutex);
+		
+		if (word.load(std::memory_order_relaxed) != s) return true;
+		if (until == nullptr)
+		{
+			bucket.parked.wait(guard);
+			return true;
+		}
+
+		return bucket.parked.wait_until(guard, *until) == std::cv_status::no_timeout;
+	}
+
+	inline void wake_all(std::atomic<std::uint32_t>& word) noexcept
+	{
+		parking_bucket& bucket = bucket_of(word);
+		{ std::lock_guard<std::mutex> guard(bucket.mutex); }
+		
+		bucket.parked.notify_all();
+	}
+
+	// the bucket might be shared with other words, so every waiter must be woken.
+	inline void wake_one(std::atomic<std::uint32_t>& word) noexcept { wake_all(word); }
+
+#endif
+
+	/**
+	 * \brief	parks the calling thread as long as word holds the value s.
+	 *			the waiting flag is set on the word before parking so the
+	 *			releasing thread knows it has to notify the parked threads.
+	 *			the function might return spuriously, the caller is expected
+	 *			to reload the word and check again.
+	 * \param	word the word to park on.
+	 * \param	s the last value of the word observed by the caller.
+	 * \param	waiting the flag in the word marking it as waited on.
+	 * \param	until the deadline for parking or null for no deadline.
+	 * \return	false if the deadline has passed.
+	 */
+	inline bool park(std::atomic<std::uint32_t>& word, std::uint32_t s, const std::uint32_t waiting, const deadline *until = nullptr) noexcept
+	{
+		if (until != nullptr && std::chrono::steady_clock::now() >= *until) return false;
+		
+		if (!(s & waiting))
+		{
+			if (!word.compare_exchange_strong(s, s | waiting, std::memory_order_relaxed))
+				return true;
+			
+			s |= waiting;
+		}
+		
+		return wait(word, s, until);
+	}
+
+	/**
+	 * \brief	hints the processor that the thread is spin waiting.
+	 */
+	inline void cpu_relax() noexcept
+	{
+#if defined(__x86_64__) || defined(__i386__)
+		__builtin_ia32_pause();
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+		_mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+		asm volatile("yield");
+#else
+		std::this_thread::yield();
+#endif
+	}
+
+	/**
+	 * \brief	exponential backoff for spin waiting, every pause waits twice
+	 *			as long as the previous one, once the longest pause is reached
+	 *			the thread yields its time slice as well.
+	 */
+	class backoff
+	{
+		static constexpr std::uint32_t MAX_PAUSES = 64;
+		
+		std::uint32_t pauses = 1;
+
+	public:
+
+		/**
+		 * \brief	waits for the next backoff period.
+		 * \return	the number of pause instructions issued.
+		 */
+		std::uint32_t pause() noexcept
+		{
+			for (std::uint32_t i = 0; i < this->pauses; ++i) cpu_relax();
+
+			const std::uint32_t spent = this->pauses;
+			if (this->pauses < MAX_PAUSES) this->pauses <<= 1;
+			else std::this_thread::yield();
+
+			return spent;
+		}
+	};
+
+	/*
+	 *	Restricted transactional memory (intel TSX), used for lock elision.
+	 *	the instructions are only available on some x86 processors so every
+	 *	use must be guarded by rtm_supported(), which checks cpuid at runtime,
+	 *	on other compilers and architectures transactions never start.
+	 */
+
+	static constexpr unsigned TRANSACTION_STARTED = ~0u;
+
+	// the bits of the status of an aborted transaction.
+	static constexpr unsigned ABORT_EXPLICIT = 1u << 0;
+	static constexpr unsigned ABORT_RETRY = 1u << 1;
+
+	inline constexpr unsigned abort_code(const unsigned status) noexcept { return (status >> 24) & 0xff; }
+
+#if defined(DMUT_EMULATE_RTM)
+
+	/*
+	 *	Emulated transactions, for testing the elision paths on processors without rtm.
+	 *	an outermost transaction holds a global mutex, so emulated transactions never
+	 *	conflict and never abort, an explicit abort terminates the program.
+	 *	the emulation does not stop threads taking the underlying lock for real,
+	 *	it is only suitable for tests whose threads only ever write to the data.
+	 */
+
+	inline std::mutex& emulated_transactions() noexcept
+	{
+		static std::mutex transactions;
+		return transactions;
+	}
+
+	inline thread_local unsigned transaction_depth = 0;
+
+	inline bool rtm_supported() noexcept { return true; }
+
+	inline unsigned begin_transaction() noexcept
+	{
+		if (transaction_depth++ == 0) emulated_transactions().lock();
+		return TRANSACTION_STARTED;
+	}
+
+	inline void end_transaction() noexcept
+	{
+		if (--transaction_depth == 0) emulated_transactions().unlock();
+	}
+
+	inline bool in_transaction() noexcept { return transaction_depth != 0; }
+
+	template <unsigned char CODE>
+	inline void abort_transaction() noexcept { std::terminate(); }
+
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+
+	inline bool rtm_supported() noexcept
+	{
+		static const bool supported = __builtin_cpu_supports("rtm");
+		return supported;
+	}
+
+	__attribute__((target("rtm"))) inline unsigned begin_transaction() noexcept { return _xbegin(); }
+	__attribute__((target("rtm"))) inline void end_transaction() noexcept { _xend(); }
+	__attribute__((target("rtm"))) inline bool in_transaction() noexcept { return _xtest() != 0; }
+
+	template <unsigned char CODE>
+	__attribute__((target("rtm"))) inline void abort_transaction() noexcept { _xabort(CODE); }
+
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+
+	inline bool rtm_supported() noexcept
+	{
+		static const bool supported = []
+		{
+			int info[4];
+			__cpuid(info, 0);
+			if (info[0] < 7) return false;
+
+			__cpuidex(info, 7, 0);
+			return (info[1] & (1 << 11)) != 0;
+		}();
+
+		return supported;
+	}
+
+	inline unsigned begin_transaction() noexcept { return _xbegin(); }
+	inline void end_transaction() noexcept { _xend(); }
+	inline bool in_transaction() noexcept { return _xtest() != 0; }
+
+	template <unsigned char CODE>
+	inline void abort_transaction() noexcept { _xabort(CODE); }
+
+#else
+
+	inline bool rtm_supported() noexcept { return false; }
+	inline unsigned begin_transaction() noexcept { return 0; }
+	inline void end_transaction() noexcept {}
+	inline bool in_transaction() noexcept { return false; }
+
+	template <unsigned char CODE>
+	inline void abort_transaction() noexcept {}
+
+#endif
 
 	/*
-	 *	These structs hold the data of the dmut.
-	 *	The structs are used instead of just having private
-	 *	members in order to have the mutexes data
-	 *	be constructed on the stack or on the heap at the users will.
-	 *	The base_mut_data holds a pointer to the data and the reader_count
-	 *	this is all that is required for the dmut to operate, but how is the
-	 *	pointer acquired ?
-	 *	if the data is created on the heap, there is no problem we create
-	 *	an instance of base_mut_data and provide it with the pointer to the heap.
-	 *	but if the data is created on the stack we create a mut_val_data which holds
-	 *	the stack allocated data and sets the base_mut_data's pointer to point to
-	 *	the stack allocated data.
-	 *	A dmut holds a pointer to base_mut_data which means it can point to both
-	 *	objects since mut_val_data inherits base_mut_data.
-	 *	This way we can use the pointer in base_mut_data without caring if it points to
-	 *	the stack or the heap, of course if it points to the heap it needs to be freed
-	 *	and if it points to the stack it must not be freed, hence there is a clean method
-	 *	in both structs, if the pointer dmut holds points to a base_mut_data the clean method
-	 *	will delete the pointer, otherwise it will do nothing since the pointer is
-	 *	pointing to a stack allocated object which must not be deleted and will get cleaned
-	 *	up automatically.
+	 *	NUMA topology, used to keep locks and data on the node of the threads using them.
+	 *	on linux the node is probed with getcpu and memory is bound with mbind,
+	 *	anywhere else the machine is treated as a single node.
+	 */
+
+#if defined(__linux__)
+
+	/**
+	 * \brief	the numa node the calling thread runs on, probed once per thread,
+	 *			a thread migrated to another node keeps reporting its first node.
+	 */
+	inline unsigned current_node() noexcept
+	{
+		thread_local const unsigned node = []
+		{
+			unsigned cpu = 0, found = 0;
+			return syscall(SYS_getcpu, &cpu, &found, nullptr) == 0 ? found : 0u;
+		}();
+
+		return node;
+	}
+
+	/**
+	 * \brief	allocates memory whose pages prefer the given numa node, the memory is
+	 *			mapped directly so its size is rounded up to whole pages.
+	 * \return	the memory or null if it could not be mapped.
+	 */
+	inline void* allocate_on_node(const std::size_t size, const unsigned node) noexcept
+	{
+		void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (memory == MAP_FAILED) return nullptr;
+
+		// the pages are placed once they are touched, the preference is a hint
+		// and the memory is still usable if the kernel refuses it.
+		constexpr unsigned long MASK_BITS = sizeof(unsigned long) * 8;
+		if (node < MASK_BITS)
+		{
+			// the kernel takes the number of nodes in the mask plus one.
+			const unsigned long mask = 1ul << node;
+			syscall(SYS_mbind, memory, size, MPOL_PREFERRED, &mask, MASK_BITS + 1, 0);
+		}
+
+		return memory;
+	}
+
+	inline void deallocate_on_node(void *memory, const std::size_t size) noexcept { munmap(memory, size); }
+
+#else
+
+	inline unsigned current_node() noexcept { return 0; }
+	inline void* allocate_on_node(const std::size_t size, unsigned) noexcept { return ::operator new(size, std::nothrow); }
+	inline void deallocate_on_node(void *memory, std::size_t) noexcept { ::operator delete(memory); }
+
+#endif
+
+	/**
+	 * \brief	a minimal lock for internal state guarded for a few instructions at a time.
+	 */
+	class spinlock
+	{
+		std::atomic<bool> locked{false};
+
+	public:
+
+		void lock() noexcept
+		{
+			backoff wait;
+			while (this->locked.exchange(true, std::memory_order_acquire))
+				while (this->locked.load(std::memory_order_relaxed)) wait.pause();
+		}
+
+		void unlock() noexcept { this->locked.store(false, std::memory_order_release); }
+	};
+
+	/**
+	 * \brief	no priority inheritance, see priority_lock.
+	 */
+	struct no_inheritance
+	{
+		void own() noexcept {}
+		void boost() noexcept {}
+		void restore() noexcept {}
+	};
+
+#if defined(__linux__)
+
+	/**
+	 * \brief	priority inheritance between the threads of a lock, a waiting thread whose
+	 *			scheduling priority is above the priority of the thread holding the lock
+	 *			raises the holder to its own priority until the lock is released.
+	 *			only realtime policies (SCHED_FIFO, SCHED_RR) have such priorities,
+	 *			and changing them may require privileges, failing to do so is ignored.
+	 *			every method is called while holding the state of the lock.
+	 */
+	class thread_inheritance
+	{
+		pthread_t owner;
+		int base = 0;
+		int boosted = 0;
+		bool owned = false;
+
+		static int own_priority() noexcept
+		{
+			int policy = 0;
+			sched_param param{};
+			return pthread_getschedparam(pthread_self(), &policy, &param) == 0 ? param.sched_priority : 0;
+		}
+
+	public:
+
+		// called by the thread acquiring the lock.
+		void own() noexcept
+		{
+			this->owner = pthread_self();
+			this->base = this->boosted = own_priority();
+			this->owned = true;
+		}
+
+		// called by a thread about to wait for the lock.
+		void boost() noexcept
+		{
+			if (!this->owned) return;
+
+			const int priority = own_priority();
+			if (priority > this->boosted && pthread_setschedprio(this->owner, priority) == 0) this->boosted = priority;
+		}
+
+		void restore() noexcept
+		{
+			if (this->owned && this->boosted != this->base) pthread_setschedprio(this->owner, this->base);
+			this->owned = false;
+		}
+	};
+
+#else
+
+	typedef no_inheritance thread_inheritance;
+
+#endif
+
+	/**
+	 * \brief	adapts one side of the lock of a dmut to the Lockable requirements
+	 *			(lock, try_lock and unlock), so several locks can be acquired with
+	 *			std::lock regardless of the mode each of them is acquired in.
+	 *			the locks std::lock backs off from are released through the dmut,
+	 *			so the coroutines waiting for them are resumed.
+	 * \tparam M the dmut whose lock is being adapted.
+	 * \tparam SHARED whether the readers side of the lock is acquired.
+	 */
+	template <typename M, bool SHARED>
+	class lockable
+	{
+		M& mutex;
+
+	public:
+
+		explicit lockable(M& mutex) noexcept : mutex(mutex) {}
+
+		void lock()
+		{
+			if constexpr (SHARED) this->mutex.lock_state.lock_shared();
+			else this->mutex.lock_state.lock();
+		}
+
+		bool try_lock()
+		{
+			const bool acquired = SHARED ? this->mutex.lock_state.try_lock_shared() : this->mutex.lock_state.try_lock();
+			if (!acquired) this->mutex.on_failed_acquire();
+
+			return acquired;
+		}
+
+		void unlock()
+		{
+			if constexpr (SHARED) this->mutex.lock_state.unlock_shared();
+			else this->mutex.lock_state.unlock();
+
+			this->mutex.resume_async();
+		}
+	};
+
+	/**
+	 * \brief	acquires all of the given locks without risking a deadlock,
+	 *			no matter the order other threads acquire them in.
+	 *			the first lock is acquired and the rest are only tried,
+	 *			if one of them is busy everything is released and the busy
+	 *			lock is waited for first (see std::lock).
+	 *			note: a lock may not be given more than once.
+	 */
+	template <typename ...L>
+	void lock_all(L& ...locks)
+	{
+		if constexpr (sizeof...(L) == 1) (locks.lock(), ...);
+		else std::lock(locks...);
+	}
+
+	// grants dmut_lock_all access to the locks of the mutexes it acquires.
+	struct access;
+
+	/**
+	 * \brief	an operation submitted to a dmut (see dmut::submit), waiting to be
+	 *			run by whichever thread holds the writers lock of the dmut.
+	 *			the operation lives on the stack of the submitting thread,
+	 *			which waits for it to be done before leaving.
+	 */
+	template <typename T>
+	struct submitted_op
+	{
+		void (*run)(submitted_op *op, T& data) noexcept;
+		submitted_op *next = nullptr;
+
+		std::exception_ptr error;
+		std::atomic<bool> done{false};
+
+		explicit submitted_op(void (*run)(submitted_op*, T&) noexcept) noexcept : run(run) {}
+	};
+
+	/**
+	 * \brief	a write queued on a dmut (see dmut::enqueue_write), the write is owned by
+	 *			the queue and is run by the next writer of the dmut releasing its lock.
+	 */
+	template <typename T>
+	struct queued_op
+	{
+		// runs the write on the data, unless it is null, and destroys it.
+		void (*run)(queued_op *op, T *data) noexcept;
+		queued_op *next = nullptr;
+
+		std::size_t key;
+		bool keyed;
+		bool superseded = false;
+
+		queued_op(void (*run)(queued_op*, T*) noexcept, const std::size_t key, const bool keyed) noexcept
+			: run(run), key(key), keyed(keyed) {}
+	};
+
+	template <typename T, typename F>
+	struct queued_call final : queued_op<T>
+	{
+		F fn;
+
+		template <typename G>
+		queued_call(G&& fn, const std::size_t key, const bool keyed)
+			: queued_op<T>(&queued_call::invoke, key, keyed), fn(std::forward<G>(fn)) {}
+
+		static void invoke(queued_op<T> *op, T *data) noexcept
+		{
+			const std::unique_ptr<queued_call> self(static_cast<queued_call*>(op));
+			if (data != nullptr) self->fn(*data);
+		}
+	};
+
+	/**
+	 * \brief	the writes queued on a dmut, created by the first write queued on it.
+	 */
+	template <typename T>
+	struct write_queue
+	{
+		// a stack holding the latest write first.
+		std::atomic<queued_op<T>*> head{nullptr};
+
+		// the keys seen while coalescing a batch, only used by the writer draining the queue.
+		std::unordered_set<std::size_t> seen;
+
+		// set while a background drainer is running.
+		std::atomic<bool> draining{false};
+
+		// set by writes queued while the drainer is running, the drainer parks on it.
+		std::atomic<std::uint32_t> signal{0};
+
+		std::thread drainer;
+	};
+
+	template <typename T, typename F>
+	struct submitted_call final : submitted_op<T>
+	{
+		typedef typename std::invoke_result<F&, T&>::type result_type;
+
+		static_assert(!std::is_reference<result_type>::value, "a submitted operation returns its result by value");
+
+		F& fn;
+
+		// the result is constructed in place by the thread running the operation.
+		std::optional<typename std::conditional<std::is_void<result_type>::value, bool, result_type>::type> result;
+
+		explicit submitted_call(F& fn) noexcept : submitted_op<T>(&submitted_call::invoke), fn(fn) {}
+
+		static void invoke(submitted_op<T> *op, T& data) noexcept
+		{
+			submitted_call *self = static_cast<submitted_call*>(op);
+
+			try
+			{
+				if constexpr (std::is_void<result_type>::value)
+				{
+					self->fn(data);
+					self->result.emplace(true);
+				}
+				else self->result.emplace(self->fn(data));
+			}
+			catch (...)
+			{
+				self->error = std::current_exception();
+			}
+		}
+	};
+
+	/**
+	 * \brief	a coroutine suspended until it is granted a lock on a dmut (see dmut::lock_async),
+	 *			the waiter lives in the frame of the suspended coroutine.
+	 */
+	struct async_waiter
+	{
+		typedef void (*resume_fn)(async_waiter *waiter) noexcept;
+
+		async_waiter *next;
+		std::coroutine_handle<> handle;
+		const resume_fn resume;
+		const bool shared;
+
+		async_waiter(const resume_fn resume, const bool shared) noexcept : next(nullptr), resume(resume), shared(shared) {}
+	};
+
+	/**
+	 * \brief	the coroutines waiting for a lock on a dmut, in the order they suspended.
+	 */
+	struct async_queue
+	{
+		// the number of waiters, checked by every thread releasing a lock.
+		std::atomic<std::size_t> waiting{0};
+
+		std::mutex guard;
+		async_waiter *head = nullptr;
+		async_waiter *tail = nullptr;
+	};
+
+	/**
+	 * \brief	a thread waiting for the data of a dmut to satisfy a predicate (see dlock::wait),
+	 *			the waiter lives on the stack of the waiting thread.
+	 */
+	struct condition_waiter
+	{
+		typedef bool (*check_fn)(void *predicate, const void *data);
+
+		condition_waiter *next = nullptr;
+		condition_waiter *prev = nullptr;
+		bool linked = false;
+
+		// evaluates the predicate of the waiter on the data, by the writers releasing the lock.
+		const check_fn check;
+		void *const predicate;
+
+		// whether the waiter waits for a writers lock, only one of those is woken at a time.
+		const bool exclusive;
+
+		// set once the waiter is woken, the waiting thread parks on it.
+		std::atomic<std::uint32_t> woken{0};
+
+		condition_waiter(const check_fn check, void *predicate, const bool exclusive) noexcept
+			: check(check), predicate(predicate), exclusive(exclusive) {}
+	};
+
+	/**
+	 * \brief	the threads waiting for the data of a dmut to satisfy their predicates,
+	 *			in the order they started waiting.
+	 */
+	struct condition_queue
+	{
+		// the number of waiters, checked by every writer releasing the lock.
+		std::atomic<std::size_t> waiting{0};
+
+		std::mutex guard;
+		condition_waiter *head = nullptr;
+		condition_waiter *tail = nullptr;
+
+		// the guard should be held by the caller of link, unlink and wake.
+		void link(condition_waiter& waiter) noexcept
+		{
+			waiter.woken.store(0, std::memory_order_relaxed);
+			waiter.next = nullptr;
+			waiter.prev = this->tail;
+			if (this->tail != nullptr) this->tail->next = &waiter;
+			else this->head = &waiter;
+			this->tail = &waiter;
+
+			waiter.linked = true;
+			this->waiting.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		void unlink(condition_waiter& waiter) noexcept
+		{
+			if (!waiter.linked) return;
+
+			if (waiter.prev != nullptr) waiter.prev->next = waiter.next;
+			else this->head = waiter.next;
+			if (waiter.next != nullptr) waiter.next->prev = waiter.prev;
+			else this->tail = waiter.prev;
+
+			waiter.linked = false;
+			this->waiting.fetch_sub(1, std::memory_order_relaxed);
+		}
+
+		// the waiting thread takes the guard before leaving, so the waiter
+		// outlives the wake up.
+		void wake(condition_waiter& waiter) noexcept
+		{
+			unlink(waiter);
+			waiter.woken.store(1, std::memory_order_release);
+			wake_one(waiter.woken);
+		}
+	};
+
+	/**
+	 * \brief	resumes a coroutine on the thread granting it the lock.
+	 */
+	struct inline_executor
+	{
+		void operator()(const std::coroutine_handle<> handle) const { handle.resume(); }
+	};
+
+	/**
+	 * \brief	holds the data of a dmut inside the dmut.
+	 * \tparam ALIGNMENT the alignment of the data, decided by the layout.
+	 */
+	template <typename T, std::size_t ALIGNMENT>
+	class inline_value
+	{
+		alignas(ALIGNMENT) T value;
+
+	public:
+
+		template <typename ...U>
+		explicit inline_value(std::in_place_t, U&& ...args) : value(std::forward<U>(args)...) {}
+
+		// the allocator is only handed to the data, which is constructed in place.
+		template <typename Allocator, typename ...U>
+		inline_value(std::allocator_arg_t, const Allocator& allocator, U&& ...args)
+			: value(std::make_obj_using_allocator<T>(allocator, std::forward<U>(args)...)) {}
+
+		T* get() noexcept { return &this->value; }
+	};
+
+	/**
+	 * \brief	holds the data of a dmut on the heap, deleting it once destroyed.
+	 *			the data can be replaced while readers still refer to it, the replaced
+	 *			data is retired and deleted once no lock can refer to it (see reclaim).
+	 */
+	template <typename T>
+	class owned_pointer
+	{
+		struct retired
+		{
+			T *value;
+			retired *next;
+		};
+
+		std::atomic<T*> value;
+
+		// a stack of replaced data which readers might still refer to.
+		std::atomic<retired*> retired_values{nullptr};
+
+	public:
+
+		explicit owned_pointer(T *value) noexcept : value(value) {}
+
+		template <typename ...U>
+		explicit owned_pointer(std::in_place_t, U&& ...args) : value(new T(std::forward<U>(args)...)) {}
+
+		// the owners of both pointers are locked, so nothing refers to the retired data.
+		owned_pointer(owned_pointer&& other) noexcept : value(other.value.exchange(nullptr, std::memory_order_relaxed)) { other.reclaim(); }
+		owned_pointer(const owned_pointer& other) = delete;
+
+		~owned_pointer()
+		{
+			reclaim();
+			delete this->value.load(std::memory_order_relaxed);
+		}
+
+		owned_pointer& operator=(const owned_pointer& other) = delete;
+		owned_pointer& operator=(owned_pointer&& other) noexcept
+		{
+			reclaim();
+			other.reclaim();
+			delete this->value.exchange(other.value.exchange(nullptr, std::memory_order_relaxed), std::memory_order_relaxed);
+			return *this;
+		}
+
+		T* get() const noexcept { return this->value.load(std::memory_order_acquire); }
+
+		/**
+		 * \brief	replaces the data, the previous data is retired.
+		 */
+		void replace(std::unique_ptr<T>& next)
+		{
+			retired *node = new retired{ nullptr, nullptr };
+			node->value = this->value.exchange(next.release(), std::memory_order_acq_rel);
+
+			node->next = this->retired_values.load(std::memory_order_relaxed);
+			while (!this->retired_values.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed)) {}
+		}
+
+		/**
+		 * \brief	replaces the data, handing the previous data to the caller.
+		 */
+		std::unique_ptr<T> exchange(std::unique_ptr<T>& next) noexcept
+		{
+			return std::unique_ptr<T>(this->value.exchange(next.release(), std::memory_order_acq_rel));
+		}
+
+		/**
+		 * \brief	deletes the retired data, should only be called when no lock
+		 *			but a writers lock held by the caller refers to the data.
+		 */
+		void reclaim() noexcept
+		{
+			if (this->retired_values.load(std::memory_order_relaxed) == nullptr) return;
+
+			retired *node = this->retired_values.exchange(nullptr, std::memory_order_acquire);
+			while (node != nullptr)
+			{
+				delete node->value;
+				delete std::exchange(node, node->next);
+			}
+		}
+	};
+
+	/**
+	 * \brief	holds the data of a dmut in memory obtained from an allocator.
+	 */
+	template <typename T, typename Allocator>
+	class allocated_value
+	{
+		typedef typename std::allocator_traits<Allocator>::template rebind_alloc<T> allocator_type;
+		typedef std::allocator_traits<allocator_type> traits;
+
+		static_assert(std::is_same<typename traits::pointer, T*>::value, "allocated_storage requires an allocator of plain pointers");
+
+		[[no_unique_address]] allocator_type allocator;
+		T *value;
+
+		template <typename ...U>
+		void emplace(U&& ...args)
+		{
+			this->value = traits::allocate(this->allocator, 1);
+
+			try
+			{
+				std::uninitialized_construct_using_allocator(this->value, this->allocator, std::forward<U>(args)...);
+			}
+			catch (...)
+			{
+				traits::deallocate(this->allocator, this->value, 1);
+				this->value = nullptr;
+				throw;
+			}
+		}
+
+		void reset() noexcept
+		{
+			if (this->value == nullptr) return;
+
+			traits::destroy(this->allocator, this->value);
+			traits::deallocate(this->allocator, this->value, 1);
+			this->value = nullptr;
+		}
+
+	public:
+
+		template <typename ...U>
+		explicit allocated_value(std::in_place_t, U&& ...args) : allocator(), value(nullptr)
+		{
+			emplace(std::forward<U>(args)...);
+		}
+
+		template <typename ...U>
+		allocated_value(std::allocator_arg_t, const Allocator& allocator, U&& ...args) : allocator(allocator), value(nullptr)
+		{
+			emplace(std::forward<U>(args)...);
+		}
+
+		allocated_value(allocated_value&& other) noexcept
+			: allocator(std::move(other.allocator)), value(std::exchange(other.value, nullptr)) {}
+
+		allocated_value(const allocated_value& other) = delete;
+		~allocated_value() { reset(); }
+
+		allocated_value& operator=(const allocated_value& other) = delete;
+
+		// follows the allocator propagation rules of the standard containers, data
+		// allocated by an allocator which is not taken along is moved element wise.
+		allocated_value& operator=(allocated_value&& other)
+		{
+			reset();
+
+			if constexpr (traits::propagate_on_container_move_assignment::value)
+				this->allocator = std::move(other.allocator);
+			else if (!(this->allocator == other.allocator))
+			{
+				if (other.value != nullptr) emplace(std::move(*other.value));
+				return *this;
+			}
+
+			this->value = std::exchange(other.value, nullptr);
+			return *this;
+		}
+
+		T* get() const noexcept { return this->value; }
+	};
+
+	/**
+	 * \brief	decides how a dmut stores its data, see the storage policies.
+	 * \tparam OFFSET the space taken by the dmut in front of the data.
+	 */
+	template <typename Storage, typename T, std::size_t OFFSET>
+	struct storage_traits;
+
+	template <typename Layout, typename T, std::size_t OFFSET>
+	struct storage_traits<inline_storage<Layout>, T, OFFSET>
+	{
+		static_assert(std::is_same<Layout, same_line_layout>::value || std::is_same<Layout, separate_line_layout>::value ||
+			std::is_same<Layout, default_layout>::value, "unknown dmut layout");
+
+		static constexpr bool SEPARATE_LINE = std::is_same<Layout, separate_line_layout>::value ||
+			(std::is_same<Layout, default_layout>::value && OFFSET + sizeof(T) > CACHE_LINE);
+
+		static constexpr bool OWNS_POINTER = false;
+
+		typedef inline_value<T, SEPARATE_LINE ? std::max(CACHE_LINE, alignof(T)) : alignof(T)> holder;
+	};
+
+	template <typename T, std::size_t OFFSET>
+	struct storage_traits<pointer_storage, T, OFFSET>
+	{
+		static constexpr bool OWNS_POINTER = true;
+
+		typedef owned_pointer<T> holder;
+	};
+
+	template <typename Allocator, typename T, std::size_t OFFSET>
+	struct storage_traits<allocated_storage<Allocator>, T, OFFSET>
+	{
+		static constexpr bool OWNS_POINTER = false;
+
+		typedef allocated_value<T, Allocator> holder;
+	};
+}
+
+
+/**
+ * \brief	Readers-Writer lock packed into a single atomic word.
+ *			the word holds a writer flag, a waiting flag, the number of
+ *			writers waiting for the lock and the number of readers currently
+ *			holding it, this way acquiring and releasing both kinds of locks
+ *			costs a single atomic read-modify-write as long as there is no contention.
+ *
+ *			when the lock cannot be acquired the thread marks the word
+ *			as waited on and parks on it (a futex on linux), the thread
+ *			releasing the lock will only notify the parked threads if
+ *			the waiting flag is set, so the uncontended release never
+ *			enters the kernel.
+ *
+ *			notes:
+ *
+ *			*	when readers are preferred a new reader may join the current
+ *				readers even if a writer is waiting, a steady stream of readers
+ *				can starve the writers.
+ *
+ *			*	when writers are preferred a new reader waits as long as some
+ *				writer is waiting, so a writer only waits for the readers that
+ *				are already inside and for the writers ahead of it,
+ *				a steady stream of writers can starve the readers.
+ *
+ *			*	in addition to readers and writers, the lock supports a single
+ *				upgradeable reader which coexists with plain readers, excludes
+ *				writers and can be promoted to a writer without releasing the lock.
+ *
+ *			*	before parking, a contended acquire spins with exponential backoff,
+ *				the lock keeps an estimate of how long recent acquires had to spin
+ *				and only spins for about twice that long, short critical sections
+ *				are then acquired without entering the kernel while waiting for long
+ *				held locks quickly stops burning cpu. the spin budget bounds the
+ *				spinning and can be changed per instance with set_spin_budget.
+ *
+ *			*	the method names match std::shared_mutex so the lock
+ *				can be used with std::lock_guard and std::shared_lock,
+ *				the upgrade methods follow the boost::upgrade_mutex naming.
+ *
+ * \tparam PREFER_WRITERS whether waiting writers keep new readers out.
+ * \tparam SPIN_BUDGET the default maximum number of pause instructions a contended
+ *			acquire may spin for before parking, 0 disables spinning.
+ */
+template <bool PREFER_WRITERS, std::uint32_t SPIN_BUDGET>
+class lock_word
+{
+	// set while a writer holds the lock.
+	static constexpr std::uint32_t WRITER = 1u << 0;
+
+	// set by a thread right before it parks on the word,
+	// tells the releasing thread that it must notify the parked threads.
+	static constexpr std::uint32_t WAITING = 1u << 1;
+
+	// set while the upgradeable reader holds the lock.
+	static constexpr std::uint32_t UPGRADER = 1u << 2;
+
+	// the number of writers waiting for the lock, only counted when writers are preferred.
+	static constexpr std::uint32_t PENDING_WRITER = 1u << 3;
+	static constexpr std::uint32_t PENDING_MASK = ((1u << 12) - 1) & ~(PENDING_WRITER - 1);
+
+	// the reader count occupies the rest of the word.
+	static constexpr std::uint32_t READER = 1u << 12;
+	static constexpr std::uint32_t READER_MASK = ~(READER - 1);
+
+	// the bits that keep a new reader from acquiring the lock.
+	static constexpr std::uint32_t READER_BLOCKED = PREFER_WRITERS ? (WRITER | PENDING_MASK) : WRITER;
+
+	// the bits that keep a new writer from acquiring the lock.
+	static constexpr std::uint32_t WRITER_BLOCKED = WRITER | UPGRADER | READER_MASK;
+
+	// the least amount of spinning allowed by the estimate, so the estimate
+	// can grow back once critical sections get short again.
+	static constexpr std::uint32_t MIN_SPIN = 16;
+
+	std::atomic<std::uint32_t> state;
+
+	std::uint32_t spin_budget;
+
+	// moving average of the number of pauses recent acquires spun before succeeding,
+	// decays when spinning fails.
+	std::atomic<std::uint32_t> spin_estimate;
+
+	/**
+	 * \brief	spins until none of the blocked bits are set in the word
+	 *			or the spin limit is reached.
+	 * \param	s the last value of the word observed by the caller,
+	 *			updated with the last value observed while spinning.
+	 * \param	blocked the bits that keep the caller from acquiring the lock.
+	 * \return	true if the lock became available while spinning.
+	 */
+	bool spin(std::uint32_t& s, const std::uint32_t blocked) noexcept
+	{
+		const std::uint32_t estimate = this->spin_estimate.load(std::memory_order_relaxed);
+		const std::uint32_t limit = std::min(this->spin_budget, 2 * estimate + MIN_SPIN);
+
+		dmut_detail::backoff backoff;
+		std::uint32_t spun = 0;
+		while (spun < limit)
+		{
+			spun += backoff.pause();
+			
+			s = this->state.load(std::memory_order_relaxed);
+			if (!(s & blocked))
+			{
+				const std::int64_t delta = (static_cast<std::int64_t>(spun) - estimate) / 8;
+				this->spin_estimate.store(static_cast<std::uint32_t>(estimate + delta), std::memory_order_relaxed);
+				return true;
+			}
+		}
+
+		this->spin_estimate.store(estimate / 2, std::memory_order_relaxed);
+		return false;
+	}
+
+	/**
+	 * \return	the spin budget of a new lock, spinning is pointless on a single
+	 *			processor since the holder cannot run while the waiter spins.
+	 */
+	static std::uint32_t default_spin_budget() noexcept
+	{
+		static const bool multiprocessor = std::thread::hardware_concurrency() > 1;
+		return multiprocessor ? SPIN_BUDGET : 0;
+	}
+
+	/**
+	 * \brief	waits for the blocked bits to clear, the first wait of an acquire
+	 *			spins before parking while later waits park right away.
+	 * \param	s the last value of the word observed by the caller, updated to its current value.
+	 * \param	blocked the bits that keep the caller from acquiring the lock.
+	 * \param	spun whether the acquire already spun, set by the method.
+	 * \param	until the deadline of the acquire or null for no deadline.
+	 * \return	false if the deadline has passed.
+	 */
+	bool wait(std::uint32_t& s, const std::uint32_t blocked, bool& spun, const dmut_detail::deadline *until = nullptr) noexcept
+	{
+		if (!spun)
+		{
+			spun = true;
+			if (spin(s, blocked)) return true;
+		}
+
+		const bool in_time = dmut_detail::park(this->state, s, WAITING, until);
+		s = this->state.load(std::memory_order_relaxed);
+		
+		return in_time;
+	}
+
+	/**
+	 * \brief	withdraws a writer that stopped waiting for the lock,
+	 *			readers that were kept out by it might be able to enter.
+	 */
+	void cancel_pending() noexcept
+	{
+		const std::uint32_t s = this->state.fetch_sub(PENDING_WRITER, std::memory_order_relaxed);
+		if ((s & PENDING_MASK) == PENDING_WRITER && (s & WAITING))
+		{
+			this->state.fetch_and(~WAITING, std::memory_order_relaxed);
+			dmut_detail::wake_all(this->state);
+		}
+	}
+
+	bool acquire(const dmut_detail::deadline *until) noexcept
+	{
+		std::uint32_t s = 0;
+		if (this->state.compare_exchange_strong(s, WRITER, std::memory_order_acquire, std::memory_order_relaxed))
+			return true;
+
+		// announce the writer so new readers stay out while it waits.
+		if (PREFER_WRITERS) s = this->state.fetch_add(PENDING_WRITER, std::memory_order_relaxed) + PENDING_WRITER;
+		
+		const std::uint32_t pending = PREFER_WRITERS ? PENDING_WRITER : 0;
+		bool spun = false;
+		for (;;)
+		{
+			if (!(s & WRITER_BLOCKED))
+			{
+				if (this->state.compare_exchange_weak(s, (s | WRITER) - pending, std::memory_order_acquire, std::memory_order_relaxed))
+					return true;
+			}
+			else if (!wait(s, WRITER_BLOCKED, spun, until))
+			{
+				if (PREFER_WRITERS) cancel_pending();
+				return false;
+			}
+		}
+	}
+
+	bool acquire_shared(const dmut_detail::deadline *until) noexcept
+	{
+		std::uint32_t s = this->state.load(std::memory_order_relaxed);
+		bool spun = false;
+		for (;;)
+		{
+			if (!(s & READER_BLOCKED))
+			{
+				if (this->state.compare_exchange_weak(s, s + READER, std::memory_order_acquire, std::memory_order_relaxed))
+					return true;
+			}
+			else if (!wait(s, READER_BLOCKED, spun, until)) return false;
+		}
+	}
+
+public:
+
+	lock_word() noexcept : state(0), spin_budget(default_spin_budget()), spin_estimate(0) {}
+	lock_word(const lock_word& other) = delete;
+	lock_word(lock_word&& other) = delete;
+
+	lock_word& operator=(const lock_word& other) = delete;
+	lock_word& operator=(lock_word&& other) = delete;
+
+	/**
+	 * \brief	sets the maximum number of pause instructions a contended
+	 *			acquire may spin for before parking.
+	 * \param	budget the number of pause instructions, 0 disables spinning.
+	 */
+	void set_spin_budget(const std::uint32_t budget) noexcept { this->spin_budget = budget; }
+
+	/**
+	 * \brief	whether any thread holds the lock, in any mode.
+	 */
+	bool is_locked() const noexcept { return (this->state.load(std::memory_order_relaxed) & WRITER_BLOCKED) != 0; }
+
+	void lock() noexcept { acquire(nullptr); }
+	bool try_lock_until(const dmut_detail::deadline& until) noexcept { return acquire(&until); }
+
+	bool try_lock() noexcept
+	{
+		std::uint32_t s = this->state.load(std::memory_order_relaxed);
+		while (!(s & WRITER_BLOCKED))
+		{
+			if (this->state.compare_exchange_weak(s, s | WRITER, std::memory_order_acquire, std::memory_order_relaxed))
+				return true;
+		}
+
+		return false;
+	}
+
+	void unlock() noexcept
+	{
+		// the waiting flag is cleared together with the writer flag,
+		// every parked thread is notified and will set it again if it
+		// still cannot acquire the lock.
+		if (this->state.fetch_and(~(WRITER | WAITING), std::memory_order_release) & WAITING)
+			dmut_detail::wake_all(this->state);
+	}
+
+	void lock_shared() noexcept { acquire_shared(nullptr); }
+	bool try_lock_shared_until(const dmut_detail::deadline& until) noexcept { return acquire_shared(&until); }
+
+	bool try_lock_shared() noexcept
+	{
+		std::uint32_t s = this->state.load(std::memory_order_relaxed);
+		while (!(s & READER_BLOCKED))
+		{
+			if (this->state.compare_exchange_weak(s, s + READER, std::memory_order_acquire, std::memory_order_relaxed))
+				return true;
+		}
+
+		return false;
+	}
+
+	void unlock_shared() noexcept
+	{
+		const std::uint32_t s = this->state.fetch_sub(READER, std::memory_order_release);
+
+		// a parked writer can only make progress once the last reader leaves,
+		// readers parked behind it will simply park again.
+		if ((s & READER_MASK) == READER && (s & WAITING))
+		{
+			this->state.fetch_and(~WAITING, std::memory_order_relaxed);
+			dmut_detail::wake_all(this->state);
+		}
+	}
+
+	void lock_upgrade() noexcept
+	{
+		std::uint32_t s = this->state.load(std::memory_order_relaxed);
+		bool spun = false;
+		for (;;)
+		{
+			if (s & (READER_BLOCKED | UPGRADER)) wait(s, READER_BLOCKED | UPGRADER, spun);
+			else if (this->state.compare_exchange_weak(s, s | UPGRADER, std::memory_order_acquire, std::memory_order_relaxed))
+				return;
+		}
+	}
+
+	bool try_lock_upgrade() noexcept
+	{
+		std::uint32_t s = this->state.load(std::memory_order_relaxed);
+		while (!(s & (READER_BLOCKED | UPGRADER)))
+		{
+			if (this->state.compare_exchange_weak(s, s | UPGRADER, std::memory_order_acquire, std::memory_order_relaxed))
+				return true;
+		}
+
+		return false;
+	}
+
+	void unlock_upgrade() noexcept
+	{
+		if (this->state.fetch_and(~(UPGRADER | WAITING), std::memory_order_release) & WAITING)
+			dmut_detail::wake_all(this->state);
+	}
+
+	/**
+	 * \brief	promotes the upgradeable reader to a writer, new readers are kept
+	 *			out from this point and the method waits for the current readers to leave.
+	 */
+	void unlock_upgrade_and_lock() noexcept
+	{
+		// no writer can be inside while the upgrader is, so the writer flag is taken
+		// immediately and only the readers already inside keep the upgrader waiting.
+		std::uint32_t s = this->state.fetch_or(WRITER, std::memory_order_relaxed) | WRITER;
+		bool spun = false;
+		while (s & READER_MASK) wait(s, READER_MASK, spun);
+
+		this->state.fetch_and(~UPGRADER, std::memory_order_acquire);
+	}
+
+	/**
+	 * \brief	turns the writer into a reader, no other writer can acquire
+	 *			the lock in between.
+	 */
+	void unlock_and_lock_shared() noexcept
+	{
+		std::uint32_t s = this->state.load(std::memory_order_relaxed);
+		while (!this->state.compare_exchange_weak(s, (s & ~(WRITER | WAITING)) + READER, std::memory_order_release, std::memory_order_relaxed)) {}
+
+		// readers parked behind the writer can join now.
+		if (s & WAITING) dmut_detail::wake_all(this->state);
+	}
+};
+
+
+/**
+ * \brief	Phase-Fair readers-writer lock (the ticket based PF-T lock
+ *			by Brandenburg and Anderson).
+ *			readers and writers alternate in phases, a writer waits for
+ *			the readers that arrived before it and for the writers ahead
+ *			of it in ticket order, while a reader waits for at most
+ *			one writer phase, this bounds the acquire latency of both
+ *			and no side can starve the other.
+ *
+ *			notes:
+ *
+ *			*	waiting threads park on the counter they wait for,
+ *				and the releasing thread only notifies when it knows
+ *				some thread is waiting for it.
+ *
+ *			*	the reader counters are kept in units of READER, up to 2^24
+ *				readers may hold the lock at once.
+ *
+ *			*	only readers support timed acquires, a writer cannot give up
+ *				its place in the ticket order.
+ */
+class phase_fair_lock
+{
+	// the writer bits in rin, set while a writer is present, the phase bit
+	// alternates between consecutive writers so readers blocked by one writer
+	// are let in by the next one.
+	static constexpr std::uint32_t PHASE = 1u << 0;
+	static constexpr std::uint32_t PRESENT = 1u << 1;
+	static constexpr std::uint32_t WRITER_BITS = PHASE | PRESENT;
+
+	// set on rin by a reader right before it parks waiting for the writer to leave.
+	static constexpr std::uint32_t WAITING = 1u << 2;
+
+	static constexpr std::uint32_t READER = 1u << 8;
+	static constexpr std::uint32_t READER_MASK = ~(READER - 1);
+
+	// readers entering and leaving the lock, rin also holds the writer bits.
+	std::atomic<std::uint32_t> rin;
+	std::atomic<std::uint32_t> rout;
+
+	// writer tickets, taken and served.
+	std::atomic<std::uint32_t> win;
+	std::atomic<std::uint32_t> wout;
+
+	/**
+	 * \brief	waits for the readers that entered before the writer holding
+	 *			the ticket to leave.
+	 * \param	entered the value of rin (reader count only) when the writer arrived.
+	 */
+	void drain_readers(const std::uint32_t entered) noexcept
+	{
+		std::uint32_t r = this->rout.load(std::memory_order_acquire);
+		while (r != entered)
+		{
+			dmut_detail::wait(this->rout, r);
+			r = this->rout.load(std::memory_order_acquire);
+		}
+	}
+
+	bool acquire_shared(const dmut_detail::deadline *until) noexcept
+	{
+		const std::uint32_t writer = this->rin.fetch_add(READER, std::memory_order_acquire) & WRITER_BITS;
+		if (writer == 0) return true;
+
+		// wait for the current writer phase to end.
+		std::uint32_t r = this->rin.load(std::memory_order_acquire);
+		while ((r & WRITER_BITS) == writer)
+		{
+			if (!dmut_detail::park(this->rin, r, WAITING, until)) return withdraw(writer);
+			
+			r = this->rin.load(std::memory_order_acquire);
+		}
+
+		return true;
+	}
+
+	/**
+	 * \brief	takes back the count of a reader whose deadline passed while it was
+	 *			blocked by a writer, the writer did not count the reader, so the
+	 *			reader must not be counted as leaving either.
+	 * \param	writer the writer bits that blocked the reader.
+	 * \return	true if the writer phase ended before the count was taken back,
+	 *			in which case the next writer already counted the reader and the
+	 *			reader holds the lock.
+	 */
+	bool withdraw(const std::uint32_t writer) noexcept
+	{
+		std::uint32_t r = this->rin.load(std::memory_order_relaxed);
+		while ((r & WRITER_BITS) == writer)
+		{
+			if (this->rin.compare_exchange_weak(r, r - READER, std::memory_order_relaxed))
+				return false;
+		}
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return true;
+	}
+
+public:
+
+	phase_fair_lock() noexcept : rin(0), rout(0), win(0), wout(0) {}
+	phase_fair_lock(const phase_fair_lock& other) = delete;
+	phase_fair_lock(phase_fair_lock&& other) = delete;
+
+	phase_fair_lock& operator=(const phase_fair_lock& other) = delete;
+	phase_fair_lock& operator=(phase_fair_lock&& other) = delete;
+
+	void lock() noexcept
+	{
+		const std::uint32_t ticket = this->win.fetch_add(1);
+
+		std::uint32_t served = this->wout.load(std::memory_order_acquire);
+		while (served != ticket)
+		{
+			dmut_detail::wait(this->wout, served);
+			served = this->wout.load(std::memory_order_acquire);
+		}
+
+		const std::uint32_t entered = this->rin.fetch_add(PRESENT | (ticket & PHASE));
+		drain_readers(entered & READER_MASK);
+	}
+
+	bool try_lock() noexcept
+	{
+		std::uint32_t ticket = this->wout.load(std::memory_order_relaxed);
+		if (!this->win.compare_exchange_strong(ticket, ticket + 1)) return false;
+
+		const std::uint32_t entered = this->rin.fetch_add(PRESENT | (ticket & PHASE));
+		if ((entered & READER_MASK) == this->rout.load(std::memory_order_acquire)) return true;
+
+		// readers are still inside, readers that arrived meanwhile are blocked
+		// by the writer bits and must be let in.
+		unlock();
+		return false;
+	}
+
+	void unlock() noexcept
+	{
+		if (this->rin.fetch_and(~(WRITER_BITS | WAITING), std::memory_order_release) & WAITING)
+			dmut_detail::wake_all(this->rin);
+
+		// the next ticket only needs a notification if someone already took it.
+		const std::uint32_t served = this->wout.fetch_add(1, std::memory_order_release) + 1;
+		if (this->win.load() != served) dmut_detail::wake_all(this->wout);
+	}
+
+	void lock_shared() noexcept { acquire_shared(nullptr); }
+	bool try_lock_shared_until(const dmut_detail::deadline& until) noexcept { return acquire_shared(&until); }
+
+	bool try_lock_shared() noexcept
+	{
+		std::uint32_t r = this->rin.load(std::memory_order_relaxed);
+		while (!(r & WRITER_BITS))
+		{
+			if (this->rin.compare_exchange_weak(r, r + READER, std::memory_order_acquire, std::memory_order_relaxed))
+				return true;
+		}
+
+		return false;
+	}
+
+	void unlock_shared() noexcept
+	{
+		this->rout.fetch_add(READER);
+
+		// only a present writer waits for readers to leave.
+		if (this->rin.load() & PRESENT) dmut_detail::wake_all(this->rout);
+	}
+
+	/**
+	 * \brief	turns the writer into a reader, the reader is counted before the
+	 *			writer leaves, so the next writer waits for it as well.
+	 */
+	void unlock_and_lock_shared() noexcept
+	{
+		this->rin.fetch_add(READER, std::memory_order_relaxed);
+		unlock();
+	}
+};
+
+
+/**
+ * \brief	Big-Reader lock, a readers-writer lock for data that is read
+ *			far more often than it is written.
+ *			instead of a single reader count the lock keeps a number of
+ *			reader slots, each on its own cache line, and every thread is
+ *			assigned to one of them, a reader only touches its own slot so
+ *			readers on different cores do not bounce a shared cache line
+ *			between them.
+ *			the price is paid by the writer, which has to scan and drain
+ *			every slot before it can enter.
+ *
+ *			notes:
+ *
+ *			*	once a writer is waiting, new readers step back until
+ *				it is done, otherwise a steady stream of readers would
+ *				never let the slots drain.
+ *
+ *			*	a slot is picked by the releasing thread and not remembered
+ *				by the lock, a lock moved to another thread and released there
+ *				leaves the two slots unbalanced, which is fine since the writer
+ *				only cares about their sum.
+ *
+ * \tparam SLOTS the number of reader slots, every slot takes a cache line.
+ */
+template <std::size_t SLOTS = 64>
+class big_reader_lock
+{
+	static_assert(SLOTS > 0, "big_reader_lock requires at least one reader slot");
+
+	static constexpr std::size_t CACHE_LINE = dmut_detail::CACHE_LINE;
+
+	// set while a writer holds the lock or is draining the readers.
+	static constexpr std::uint32_t WRITER = 1u << 0;
+
+	// set by a thread right before it parks on the writer word.
+	static constexpr std::uint32_t WAITING = 1u << 1;
+
+	struct alignas(CACHE_LINE) reader_slot
+	{
+		// signed since a lock might be released from a different slot than
+		// the one it was acquired on.
+		std::atomic<std::int64_t> readers{0};
+	};
+
+	reader_slot slots[SLOTS];
+
+	// kept away from the slots so writers polling it do not disturb the readers.
+	alignas(CACHE_LINE) std::atomic<std::uint32_t> writer;
+
+	// bumped by every reader leaving while a writer is draining,
+	// the writer parks on it until the slots are empty.
+	std::atomic<std::uint32_t> drained;
+
+	/**
+	 * \return the slot assigned to the calling thread,
+	 *			threads are assigned to slots in a round robin fashion.
+	 */
+	reader_slot& own_slot() noexcept
+	{
+		static std::atomic<std::size_t> next_slot(0);
+		thread_local const std::size_t slot = next_slot.fetch_add(1, std::memory_order_relaxed);
+		
+		return this->slots[slot % SLOTS];
+	}
+
+	std::int64_t reader_count() const noexcept
+	{
+		std::int64_t sum = 0;
+		for (const reader_slot& slot : this->slots) sum += slot.readers.load();
+		
+		return sum;
+	}
+
+	/**
+	 * \brief	removes a reader from the slot, notifying the writer
+	 *			if it is waiting for the readers to drain.
+	 */
+	void leave(reader_slot& slot) noexcept
+	{
+		slot.readers.fetch_sub(1);
+		if (this->writer.load() & WRITER)
+		{
+			this->drained.fetch_add(1, std::memory_order_release);
+			dmut_detail::wake_one(this->drained);
+		}
+	}
+
+	bool acquire(const dmut_detail::deadline *until) noexcept
+	{
+		std::uint32_t w = 0;
+		for (;;)
+		{
+			if (!(w & WRITER))
+			{
+				if (this->writer.compare_exchange_weak(w, w | WRITER)) break;
+			}
+			else
+			{
+				if (!dmut_detail::park(this->writer, w, WAITING, until)) return false;
+				w = this->writer.load(std::memory_order_relaxed);
+			}
+		}
+
+		// no new reader can enter from this point, wait for the current ones to leave.
+		for (;;)
+		{
+			const std::uint32_t d = this->drained.load(std::memory_order_acquire);
+			if (reader_count() == 0) return true;
+			
+			const bool in_time = until == nullptr || std::chrono::steady_clock::now() < *until;
+			if (!in_time || !dmut_detail::wait(this->drained, d, until))
+			{
+				// readers that stepped back while the flag was set are waiting for it to clear.
+				unlock();
+				return false;
+			}
+		}
+	}
+
+	bool acquire_shared(const dmut_detail::deadline *until) noexcept
+	{
+		reader_slot& slot = own_slot();
+		for (;;)
+		{
+			slot.readers.fetch_add(1);
+
+			std::uint32_t w = this->writer.load();
+			if (!(w & WRITER)) return true;
+
+			// a writer is in, step back and wait for it to leave.
+			leave(slot);
+			while (w & WRITER)
+			{
+				if (!dmut_detail::park(this->writer, w, WAITING, until)) return false;
+				w = this->writer.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+public:
+
+	big_reader_lock() noexcept : writer(0), drained(0) {}
+	big_reader_lock(const big_reader_lock& other) = delete;
+	big_reader_lock(big_reader_lock&& other) = delete;
+
+	big_reader_lock& operator=(const big_reader_lock& other) = delete;
+	big_reader_lock& operator=(big_reader_lock&& other) = delete;
+
+	void lock() noexcept { acquire(nullptr); }
+	bool try_lock_until(const dmut_detail::deadline& until) noexcept { return acquire(&until); }
+
+	bool try_lock() noexcept
+	{
+		std::uint32_t w = this->writer.load(std::memory_order_relaxed);
+		while (!(w & WRITER))
+		{
+			if (this->writer.compare_exchange_weak(w, w | WRITER))
+			{
+				if (reader_count() == 0) return true;
+
+				// readers that stepped back while the flag was set are waiting for it to clear.
+				unlock();
+				return false;
+			}
+		}
+
+		return false;
+	}
+
+	void unlock() noexcept
+	{
+		if (this->writer.fetch_and(~(WRITER | WAITING), std::memory_order_release) & WAITING)
+			dmut_detail::wake_all(this->writer);
+	}
+
+	void lock_shared() noexcept { acquire_shared(nullptr); }
+	bool try_lock_shared_until(const dmut_detail::deadline& until) noexcept { return acquire_shared(&until); }
+
+	bool try_lock_shared() noexcept
+	{
+		reader_slot& slot = own_slot();
+		slot.readers.fetch_add(1);
+		
+		if (!(this->writer.load() & WRITER)) return true;
+
+		leave(slot);
+		return false;
+	}
+
+	void unlock_shared() noexcept { leave(own_slot()); }
+
+	/**
+	 * \brief	turns the writer into a reader, the reader is counted while the
+	 *			writer flag is still set, so no other writer can get in between.
+	 */
+	void unlock_and_lock_shared() noexcept
+	{
+		own_slot().readers.fetch_add(1);
+		unlock();
+	}
+};
+
+/**
+ * \brief	Lock elision on top of a readers-writer lock, using hardware transactional
+ *			memory (intel TSX) when the processor supports it.
+ *			a writer first runs its critical section as a transaction which only
+ *			reads the lock, so writers touching different parts of the data run in
+ *			parallel, and only when the transaction keeps aborting (the writers
+ *			really conflict or the section cannot run transactionally) the writer
+ *			takes the underlying lock.
+ *
+ *			notes:
+ *
+ *			*	support is checked at runtime (cpuid), without it every writer
+ *				takes the underlying lock right away.
+ *
+ *			*	readers, upgradeable readers and timed writers always take the
+ *				underlying lock, a thread taking the lock for real aborts all the
+ *				transactions eliding it.
+ *
+ *			*	a critical section making a system call or touching too much memory
+ *				always aborts, elision pays off for short sections on large data
+ *				where writers rarely touch the same cache lines, the counters
+ *				(see stats) tell whether it does.
+ *
+ *			*	a dmut using an eliding lock does not maintain its seqlock version,
+ *				since every writer would conflict on it, so read_optimistic is not
+ *				available, and its data does not share the line of the lock.
+ *
+ * \tparam Lock the underlying lock, must provide is_locked(), see lock_word.
+ * \tparam ATTEMPTS the number of transactions attempted before taking the underlying lock.
+ */
+template <typename Lock = reader_preferring_lock, unsigned ATTEMPTS = 3>
+class elision_lock
+{
+	// the codes of explicit aborts.
+	static constexpr unsigned char LOCKED = 0xff;
+	static constexpr unsigned char UNSUPPORTED = 0xfe;
+
+	Lock lock_state;
+
+	// kept away from the lock so counting does not abort the transactions reading it.
+	alignas(dmut_detail::CACHE_LINE) std::atomic<std::uint64_t> commits;
+	std::atomic<std::uint64_t> aborts;
+	std::atomic<std::uint64_t> fallbacks;
+
+	/**
+	 * \brief	whether the calling thread is eliding the lock, a thread holding
+	 *			the underlying lock might be inside a transaction eliding another
+	 *			lock, but the transaction of a thread eliding this lock aborts
+	 *			as soon as the underlying lock is taken by anyone.
+	 */
+	bool eliding() const noexcept
+	{
+		return dmut_detail::rtm_supported() && dmut_detail::in_transaction() && !this->lock_state.is_locked();
+	}
+
+public:
+
+	/**
+	 * \brief	counters of the elision attempts of a lock,
+	 *			the counters are updated without synchronizing with each other.
+	 */
+	struct elision_stats
+	{
+		// critical sections completed as transactions.
+		std::uint64_t commits;
+
+		// aborted transactions.
+		std::uint64_t aborts;
+
+		// critical sections that took the underlying lock.
+		std::uint64_t fallbacks;
+	};
+
+	static constexpr bool ELIDES_WRITERS = true;
+
+	elision_lock() noexcept : commits(0), aborts(0), fallbacks(0) {}
+	elision_lock(const elision_lock& other) = delete;
+	elision_lock(elision_lock&& other) = delete;
+
+	elision_lock& operator=(const elision_lock& other) = delete;
+	elision_lock& operator=(elision_lock&& other) = delete;
+
+	void lock() noexcept
+	{
+		if (dmut_detail::rtm_supported())
+		{
+			// a lock acquired inside a transaction nests a transaction of its own, so ending
+			// it in unlock leaves the outer transaction running, nested transactions
+			// commit (or abort) along with the outermost one.
+			if (dmut_detail::in_transaction())
+			{
+				dmut_detail::begin_transaction();
+				if (this->lock_state.is_locked()) dmut_detail::abort_transaction<LOCKED>();
+				return;
+			}
+
+			for (unsigned attempt = 0; attempt < ATTEMPTS; ++attempt)
+			{
+				const unsigned status = dmut_detail::begin_transaction();
+				if (status == dmut_detail::TRANSACTION_STARTED)
+				{
+					// reading the lock puts it in the read set of the transaction,
+					// from now on anyone taking the lock aborts the transaction.
+					if (!this->lock_state.is_locked()) return;
+					dmut_detail::abort_transaction<LOCKED>();
+				}
+
+				this->aborts.fetch_add(1, std::memory_order_relaxed);
+
+				const bool explicit_abort = (status & dmut_detail::ABORT_EXPLICIT) != 0;
+				if (explicit_abort && dmut_detail::abort_code(status) == UNSUPPORTED) break;
+				
+				if (explicit_abort && dmut_detail::abort_code(status) == LOCKED)
+				{
+					// starting over while the lock is held would only abort again.
+					dmut_detail::backoff backoff;
+					for (unsigned i = 0; i < 16 && this->lock_state.is_locked(); ++i) backoff.pause();
+					continue;
+				}
+
+				if (!(status & dmut_detail::ABORT_RETRY)) break;
+			}
+		}
+
+		this->fallbacks.fetch_add(1, std::memory_order_relaxed);
+		this->lock_state.lock();
+	}
+
+	bool try_lock() noexcept { return this->lock_state.try_lock(); }
+	bool try_lock_until(const dmut_detail::deadline& until) noexcept { return this->lock_state.try_lock_until(until); }
+
+	void unlock() noexcept
+	{
+		if (eliding())
+		{
+			dmut_detail::end_transaction();
+			
+			// only the outermost transaction commits.
+			if (!dmut_detail::in_transaction()) this->commits.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+
+		this->lock_state.unlock();
+	}
+
+	void lock_shared() noexcept { this->lock_state.lock_shared(); }
+	bool try_lock_shared() noexcept { return this->lock_state.try_lock_shared(); }
+	bool try_lock_shared_until(const dmut_detail::deadline& until) noexcept { return this->lock_state.try_lock_shared_until(until); }
+	void unlock_shared() noexcept { this->lock_state.unlock_shared(); }
+
+	void lock_upgrade() noexcept { this->lock_state.lock_upgrade(); }
+	bool try_lock_upgrade() noexcept { return this->lock_state.try_lock_upgrade(); }
+	void unlock_upgrade() noexcept { this->lock_state.unlock_upgrade(); }
+	void unlock_upgrade_and_lock() noexcept { this->lock_state.unlock_upgrade_and_lock(); }
+
+	/**
+	 * \brief	turns the writer into a reader, an elided writer cannot become a reader
+	 *			without leaving its transaction, so the transaction is aborted and the
+	 *			critical section starts over holding the underlying lock.
+	 */
+	void unlock_and_lock_shared() noexcept
+	{
+		if (eliding()) dmut_detail::abort_transaction<UNSUPPORTED>();
+		this->lock_state.unlock_and_lock_shared();
+	}
+
+	bool is_locked() const noexcept { return this->lock_state.is_locked(); }
+
+	void set_spin_budget(const std::uint32_t budget) noexcept { this->lock_state.set_spin_budget(budget); }
+
+	/**
+	 * \brief	the elision counters of the lock.
+	 */
+	elision_stats stats() const noexcept
+	{
+		return elision_stats{ this->commits.load(std::memory_order_relaxed), this->aborts.load(std::memory_order_relaxed),
+			this->fallbacks.load(std::memory_order_relaxed) };
+	}
+};
+
+
+/**
+ * \brief	Cohort lock, a readers-writer lock for machines with several numa nodes.
+ *			writers first queue on a lock local to their node (a ticket lock on a cache
+ *			line of its own) and only the head of a node queues on the global lock,
+ *			when a writer leaves while writers of its node are waiting, it hands the
+ *			global lock directly to the next of them, so the lock, and the data it
+ *			guards, stay in the caches of one node for a batch of writers instead of
+ *			crossing the interconnect on every handoff.
+ *
+ *			notes:
+ *
+ *			*	a node hands the global lock over at most HANDOFFS times in a row,
+ *				then releases it so writers and readers of the other nodes get in.
+ *
+ *			*	readers use the global lock shared, choose a global lock with
+ *				per core reader slots (big_reader_lock) for data that is mostly read.
+ *
+ *			*	a thread is assigned to the node it first ran on, a lock released
+ *				by another thread is released on the node it was acquired on.
+ *
+ *			*	a writer that takes its place in the queue of its node cannot leave it,
+ *				so timed acquires are not supported, and neither are upgradeable readers.
+ *
+ *			*	to place the data itself on a node see numa_allocator.
+ *
+ * \tparam Lock the global lock, must support try_lock and unlock_and_lock_shared to be used
+ *			with the matching dmut operations.
+ * \tparam NODES the number of node queues, nodes beyond it share queues.
+ * \tparam HANDOFFS the longest batch of writers a node serves while holding the global lock.
+ */
+template <typename Lock = reader_preferring_lock, std::size_t NODES = 4, std::uint32_t HANDOFFS = 64>
+class cohort_lock
+{
+	static_assert(NODES > 0, "cohort_lock requires at least one node");
+	static_assert(HANDOFFS > 0, "cohort_lock requires at least one handoff");
+
+	static constexpr std::size_t CACHE_LINE = dmut_detail::CACHE_LINE;
+
+	// the number of backoff rounds a writer spins for its turn before parking.
+	static constexpr unsigned SPIN_ROUNDS = 8;
+
+	struct alignas(CACHE_LINE) cohort
+	{
+		// the next ticket to hand out and the ticket allowed in.
+		std::atomic<std::uint32_t> ticket{0};
+		std::atomic<std::uint32_t> serving{0};
+
+		// only accessed by the writer holding the local lock, published along with serving.
+		bool owns_global = false;
+		std::uint32_t handoffs = 0;
+	};
+
+	cohort cohorts[NODES];
+
+	alignas(CACHE_LINE) Lock global;
+
+	// the cohort of the current writer, only accessed by the writer.
+	std::size_t holder;
+
+	static std::size_t own_cohort() noexcept { return dmut_detail::current_node() % NODES; }
+
+	/**
+	 * \brief	releases the local lock of a cohort, letting its next writer in.
+	 */
+	static void leave(cohort& c) noexcept
+	{
+		const std::uint32_t next = c.serving.load(std::memory_order_relaxed) + 1;
+		c.serving.store(next);
+
+		// a writer taking a ticket from now on sees the new turn before parking.
+		if (c.ticket.load() != next) dmut_detail::wake_all(c.serving);
+	}
+
+public:
+
+	cohort_lock() noexcept : holder(0) {}
+	cohort_lock(const cohort_lock& other) = delete;
+	cohort_lock(cohort_lock&& other) = delete;
+
+	cohort_lock& operator=(const cohort_lock& other) = delete;
+	cohort_lock& operator=(cohort_lock&& other) = delete;
+
+	void lock() noexcept
+	{
+		const std::size_t index = own_cohort();
+		cohort& c = this->cohorts[index];
+
+		const std::uint32_t turn = c.ticket.fetch_add(1);
+
+		dmut_detail::backoff backoff;
+		for (unsigned round = 0; c.serving.load(std::memory_order_acquire) != turn; ++round)
+		{
+			if (round < SPIN_ROUNDS) backoff.pause();
+			else
+			{
+				const std::uint32_t s = c.serving.load(std::memory_order_acquire);
+				if (s != turn) dmut_detail::wait(c.serving, s);
+			}
+		}
+
+		// the previous writer of the cohort might have handed the global lock over.
+		if (!c.owns_global)
+		{
+			this->global.lock();
+			c.owns_global = true;
+		}
+
+		this->holder = index;
+	}
+
+	bool try_lock() noexcept
+	{
+		const std::size_t index = own_cohort();
+		cohort& c = this->cohorts[index];
+
+		// the local lock is free only when no ticket is handed out beyond the one being served.
+		std::uint32_t turn = c.serving.load(std::memory_order_acquire);
+		if (!c.ticket.compare_exchange_strong(turn, turn + 1, std::memory_order_relaxed)) return false;
+
+		if (!c.owns_global)
+		{
+			if (!this->global.try_lock())
+			{
+				leave(c);
+				return false;
+			}
+
+			c.owns_global = true;
+		}
+
+		this->holder = index;
+		return true;
+	}
+
+	void unlock() noexcept
+	{
+		cohort& c = this->cohorts[this->holder];
+
+		// writers of the cohort are waiting, the global lock goes along with the local lock.
+		const bool waiting = c.ticket.load(std::memory_order_relaxed) != c.serving.load(std::memory_order_relaxed) + 1;
+		if (waiting && ++c.handoffs < HANDOFFS)
+		{
+			leave(c);
+			return;
+		}
+
+		c.handoffs = 0;
+		c.owns_global = false;
+		this->global.unlock();
+		leave(c);
+	}
+
+	void lock_shared() noexcept { this->global.lock_shared(); }
+	bool try_lock_shared() noexcept { return this->global.try_lock_shared(); }
+	void unlock_shared() noexcept { this->global.unlock_shared(); }
+
+	/**
+	 * \brief	turns the writer into a reader, the global lock is turned into a
+	 *			readers lock and the next writer of the cohort queues on it.
+	 */
+	void unlock_and_lock_shared() noexcept
+	{
+		cohort& c = this->cohorts[this->holder];
+
+		c.handoffs = 0;
+		c.owns_global = false;
+		this->global.unlock_and_lock_shared();
+		leave(c);
+	}
+};
+
+/**
+ * \brief	Priority lock, a readers-writer lock serving its waiters by priority instead
+ *			of by chance, so a background job waiting for the lock does not get it
+ *			ahead of a latency critical thread.
+ *			a thread that cannot get the lock right away queues with a priority
+ *			(higher is served first) and a deadline (sooner is served first among
+ *			equal priorities), waiters of equal rank are served in the order they came.
+ *			the waiters are nodes on the stacks of the waiting threads, the releasing
+ *			thread hands the lock to the first waiter (or to the readers at the head
+ *			of the queue) and wakes it directly.
+ *
+ *			notes:
+ *
+ *			*	while threads are queued no thread acquires the lock without queuing,
+ *				so the order is kept at the price of some throughput, every acquire and
+ *				release takes a short internal spinlock.
+ *
+ *			*	the timed acquires (try_lock_until) rank their waiters by their deadline.
+ *
+ *			*	upgradeable readers are not supported.
+ *
+ *			*	with INHERIT_PRIORITY (for realtime builds on linux) a waiting thread with
+ *				a higher scheduling priority than the writer holding the lock raises
+ *				the writer to its own priority until the lock is released, the writer
+ *				is expected to release the lock on the thread that acquired it.
+ *
+ * \tparam INHERIT_PRIORITY whether a writer inherits the scheduling priority of its waiters.
+ */
+template <bool INHERIT_PRIORITY = false>
+class priority_lock
+{
+	struct waiter
+	{
+		const unsigned priority;
+		const dmut_detail::deadline due;
+		const bool shared;
+
+		// set once the lock is handed to the waiter, the waiter parks on it.
+		std::atomic<std::uint32_t> granted{0};
+
+		waiter *next = nullptr;
+
+		bool before(const waiter& other) const noexcept
+		{
+			return this->priority > other.priority || (this->priority == other.priority && this->due < other.due);
+		}
+	};
+
+	dmut_detail::spinlock guard;
+
+	std::size_t readers;
+	bool writer;
+
+	// sorted by rank, the first waiter is served next.
+	waiter *head;
+
+	[[no_unique_address]] typename std::conditional<INHERIT_PRIORITY,
+		dmut_detail::thread_inheritance, dmut_detail::no_inheritance>::type inheritance;
+
+	bool available(const bool shared) const noexcept { return !this->writer && (shared || this->readers == 0); }
+
+	void take(const bool shared) noexcept
+	{
+		if (shared) ++this->readers;
+		else
+		{
+			this->writer = true;
+			this->inheritance.own();
+		}
+	}
+
+	void enqueue(waiter& w) noexcept
+	{
+		waiter **at = &this->head;
+		while (*at != nullptr && !w.before(**at)) at = &(*at)->next;
+
+		w.next = *at;
+		*at = &w;
+	}
+
+	/**
+	 * \return	false if the waiter is not queued, since it was just granted the lock.
+	 */
+	bool dequeue(waiter& w) noexcept
+	{
+		waiter **at = &this->head;
+		while (*at != nullptr && *at != &w) at = &(*at)->next;
+		if (*at == nullptr) return false;
+
+		*at = w.next;
+		return true;
+	}
+
+	/**
+	 * \brief	hands the lock to the waiters at the head of the queue for as long as they can
+	 *			hold it together, should be called while holding the guard.
+	 * \return	the waiters granted the lock, to be woken once the guard is released.
+	 */
+	waiter* grant() noexcept
+	{
+		waiter *granted = nullptr;
+		while (this->head != nullptr && available(this->head->shared))
+		{
+			waiter *w = std::exchange(this->head, this->head->next);
+
+			// a writer records itself as the owner once it runs.
+			if (w->shared) ++this->readers;
+			else this->writer = true;
+
+			w->next = granted;
+			granted = w;
+			if (!w->shared) break;
+		}
+
+		return granted;
+	}
+
+	static void wake(waiter *granted) noexcept
+	{
+		while (granted != nullptr)
+		{
+			waiter *next = granted->next;
+			std::atomic<std::uint32_t>& word = granted->granted;
+
+			// the waiter may return as soon as it sees the store, waking an address
+			// reused by another parked word only causes a spurious wake up.
+			word.store(1, std::memory_order_release);
+			dmut_detail::wake_one(word);
+			granted = next;
+		}
+	}
+
+	bool acquire(const bool shared, const unsigned priority, const dmut_detail::deadline& due, const dmut_detail::deadline *until) noexcept
+	{
+		this->guard.lock();
+		if (this->head == nullptr && available(shared))
+		{
+			take(shared);
+			this->guard.unlock();
+			return true;
+		}
+
+		waiter w{ priority, due, shared };
+		enqueue(w);
+		this->inheritance.boost();
+
+		// a waiter ranked ahead of the queue might fit in with the current holders.
+		waiter *granted = grant();
+		this->guard.unlock();
+		wake(granted);
+
+		while (w.granted.load(std::memory_order_acquire) == 0)
+		{
+			if (dmut_detail::wait(w.granted, 0, until)) continue;
+
+			this->guard.lock();
+			if (!dequeue(w))
+			{
+				// the lock was handed over right before the deadline, the waker is about to say so.
+				this->guard.unlock();
+				while (w.granted.load(std::memory_order_acquire) == 0) dmut_detail::cpu_relax();
+				break;
+			}
+
+			// the waiters behind might be able to hold the lock without this one.
+			granted = grant();
+			this->guard.unlock();
+			wake(granted);
+			return false;
+		}
+
+		if (!shared && INHERIT_PRIORITY)
+		{
+			std::lock_guard<dmut_detail::spinlock> lock(this->guard);
+			this->inheritance.own();
+		}
+
+		return true;
+	}
+
+	bool try_acquire(const bool shared) noexcept
+	{
+		std::lock_guard<dmut_detail::spinlock> lock(this->guard);
+		if (this->head != nullptr || !available(shared)) return false;
+
+		take(shared);
+		return true;
+	}
+
+	void release(const bool shared) noexcept
+	{
+		this->guard.lock();
+		if (shared) --this->readers;
+		else
+		{
+			this->writer = false;
+			this->inheritance.restore();
+		}
+
+		waiter *granted = grant();
+		this->guard.unlock();
+		wake(granted);
+	}
+
+	static constexpr dmut_detail::deadline NO_DEADLINE = dmut_detail::deadline::max();
+
+public:
+
+	static constexpr unsigned DEFAULT_PRIORITY = 0;
+
+	priority_lock() noexcept : readers(0), writer(false), head(nullptr) {}
+	priority_lock(const priority_lock& other) = delete;
+	priority_lock(priority_lock&& other) = delete;
+
+	priority_lock& operator=(const priority_lock& other) = delete;
+	priority_lock& operator=(priority_lock&& other) = delete;
+
+	/**
+	 * \brief	acquires the writers lock, queuing with the given rank if it is not available.
+	 * \param	priority waiters of higher priority are served first.
+	 * \param	due waiters of equal priority are served by the soonest deadline,
+	 *			the deadline only orders the waiters, the acquire does not expire.
+	 */
+	void lock(const unsigned priority, const dmut_detail::deadline& due = NO_DEADLINE) noexcept
+	{
+		acquire(false, priority, due, nullptr);
+	}
+
+	void lock() noexcept { lock(DEFAULT_PRIORITY); }
+	bool try_lock() noexcept { return try_acquire(false); }
+	bool try_lock_until(const dmut_detail::deadline& until) noexcept { return acquire(false, DEFAULT_PRIORITY, until, &until); }
+	void unlock() noexcept { release(false); }
+
+	/**
+	 * \brief	acquires a readers lock, queuing with the given rank if it is not available, see lock.
+	 */
+	void lock_shared(const unsigned priority, const dmut_detail::deadline& due = NO_DEADLINE) noexcept
+	{
+		acquire(true, priority, due, nullptr);
+	}
+
+	void lock_shared() noexcept { lock_shared(DEFAULT_PRIORITY); }
+	bool try_lock_shared() noexcept { return try_acquire(true); }
+	bool try_lock_shared_until(const dmut_detail::deadline& until) noexcept { return acquire(true, DEFAULT_PRIORITY, until, &until); }
+	void unlock_shared() noexcept { release(true); }
+
+	/**
+	 * \brief	turns the writer into a reader, the readers at the head of the queue join it.
+	 */
+	void unlock_and_lock_shared() noexcept
+	{
+		this->guard.lock();
+		this->writer = false;
+		this->inheritance.restore();
+		++this->readers;
+
+		waiter *granted = grant();
+		this->guard.unlock();
+		wake(granted);
+	}
+};
+
+/**
+ * \brief	an allocator placing memory on a numa node, meant to keep the data of
+ *			a dmut on the node of the threads using it, along with a cohort_lock:
+ *			\code
+ *			dmut<T, cohort_lock<>, allocated_storage<numa_allocator<std::byte>>> m(std::allocator_arg, numa_allocator<std::byte>(node), args...);
+ *			\endcode
+ *			every allocation is mapped pages of its own, so the allocator is meant
+ *			for a few large objects rather than for containers of small elements.
+ *			on platforms without numa support the memory is allocated normally.
+ * \tparam T the type of the allocated objects.
+ */
+template <typename T>
+class numa_allocator
+{
+	template <typename>
+	friend class numa_allocator;
+
+	unsigned node;
+
+public:
+
+	typedef T value_type;
+
+	/**
+	 * \param node the numa node to place memory on, by default the node of the calling thread.
+	 */
+	explicit numa_allocator(const unsigned node = dmut_detail::current_node()) noexcept : node(node) {}
+
+	template <typename U>
+	numa_allocator(const numa_allocator<U>& other) noexcept : node(other.node) {}
+
+	T* allocate(const std::size_t n)
+	{
+		if (n > std::size_t(-1) / sizeof(T)) throw std::bad_array_new_length();
+
+		void *memory = dmut_detail::allocate_on_node(n * sizeof(T), this->node);
+		if (memory == nullptr) throw std::bad_alloc();
+
+		return static_cast<T*>(memory);
+	}
+
+	void deallocate(T *memory, const std::size_t n) noexcept { dmut_detail::deallocate_on_node(memory, n * sizeof(T)); }
+
+	/**
+	 * \brief	the numa node the allocator places memory on.
+	 */
+	unsigned numa_node() const noexcept { return this->node; }
+
+	template <typename U>
+	bool operator==(const numa_allocator<U>& other) const noexcept { return this->node == other.node; }
+};
+
+/**
+ * \brief	a pool of threads running bulk operations on the data of a dmut while a
+ *			single lock is held, see dmut::parallel_write and dmut::parallel_read.
+ *			a batch of work is split into chunks, every thread starts with chunks of
+ *			its own and steals the chunks of the others once it is done with them,
+ *			so threads slowed down by the rest of the system do not delay the batch.
+ *			the thread running a batch works on it as well, a pool of a single
+ *			thread runs every batch on the calling thread.
+ *			note: batches of a pool run one at a time, a batch should not run
+ *			another batch on the same pool.
+ */
+class thread_pool
+{
+	// a share of the chunks of a batch, claimed one by one by its owner and by thieves.
+	struct alignas(dmut_detail::CACHE_LINE) share
+	{
+		std::atomic<std::size_t> next{0};
+		std::size_t end = 0;
+	};
+
+	// every batch is split into this many chunks per thread, leaving room for stealing.
+	static constexpr std::size_t CHUNKS_PER_THREAD = 8;
+
+	std::unique_ptr<share[]> shares;
+	std::vector<std::thread> workers;
+
+	// excludes batches from each other.
+	std::mutex running;
+
+	// bumped for every batch, idle workers park on it.
+	std::atomic<std::uint32_t> generation{0};
+	bool stopping = false;
+
+	// the threads that did not finish the current batch yet, the thread running it parks on it.
+	std::atomic<std::uint32_t> remaining{0};
+
+	// the current batch.
+	void (*call)(void *context, std::size_t begin, std::size_t end) = nullptr;
+	void *context = nullptr;
+	std::size_t count = 0;
+	std::size_t grain = 0;
+
+	// the first exception thrown by the current batch, the rest of its chunks are skipped.
+	std::atomic<bool> failed{false};
+	std::exception_ptr failure;
+
+	/**
+	 * \brief	runs chunks of the current batch until none is left,
+	 *			starting with the share of the given thread.
+	 */
+	void work(const std::size_t self) noexcept
+	{
+		const std::size_t threads = this->workers.size() + 1;
+		for (std::size_t i = 0; i < threads; ++i)
+		{
+			share& chunks = this->shares[(self + i) % threads];
+			for (std::size_t chunk = chunks.next.fetch_add(1, std::memory_order_relaxed); chunk < chunks.end;
+				chunk = chunks.next.fetch_add(1, std::memory_order_relaxed))
+			{
+				if (this->failed.load(std::memory_order_relaxed)) return;
+
+				const std::size_t begin = chunk * this->grain;
+				try
+				{
+					this->call(this->context, begin, std::min(begin + this->grain, this->count));
+				}
+				catch (...)
+				{
+					if (!this->failed.exchange(true, std::memory_order_relaxed)) this->failure = std::current_exception();
+					return;
+				}
+			}
+		}
+	}
+
+	void finish() noexcept
+	{
+		if (this->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) dmut_detail::wake_one(this->remaining);
+	}
+
+	void run_worker(const std::size_t self) noexcept
+	{
+		std::uint32_t seen = 0;
+		for (;;)
+		{
+			std::uint32_t current;
+			while ((current = this->generation.load(std::memory_order_acquire)) == seen) dmut_detail::wait(this->generation, seen);
+			seen = current;
+
+			if (this->stopping) return;
+
+			work(self);
+			finish();
+		}
+	}
+
+	void stop() noexcept
+	{
+		this->stopping = true;
+		this->generation.fetch_add(1, std::memory_order_release);
+		dmut_detail::wake_all(this->generation);
+
+		for (std::thread& worker : this->workers) worker.join();
+		this->workers.clear();
+	}
+
+	void dispatch(const std::size_t n, void (*fn)(void*, std::size_t, std::size_t), void *fn_context)
+	{
+		if (n == 0) return;
+
+		std::lock_guard<std::mutex> guard(this->running);
+
+		const std::size_t threads = this->workers.size() + 1;
+		const std::size_t chunks = std::min(n, threads * CHUNKS_PER_THREAD);
+
+		this->call = fn;
+		this->context = fn_context;
+		this->count = n;
+		this->grain = (n + chunks - 1) / chunks;
+		this->failed.store(false, std::memory_order_relaxed);
+		this->failure = nullptr;
+
+		// the chunks are split evenly between the threads, rounding the grain up
+		// may leave the last threads with fewer chunks (or none).
+		const std::size_t used = (n + this->grain - 1) / this->grain;
+		for (std::size_t i = 0; i < threads; ++i)
+		{
+			this->shares[i].next.store(used * i / threads, std::memory_order_relaxed);
+			this->shares[i].end = used * (i + 1) / threads;
+		}
+
+		if (threads > 1)
+		{
+			this->remaining.store(static_cast<std::uint32_t>(threads), std::memory_order_relaxed);
+			this->generation.fetch_add(1, std::memory_order_release);
+			dmut_detail::wake_all(this->generation);
+		}
+
+		work(0);
+
+		if (threads > 1)
+		{
+			// every worker takes part in every batch, so the batch can be reused
+			// once all of them are done with it.
+			finish();
+
+			std::uint32_t left;
+			while ((left = this->remaining.load(std::memory_order_acquire)) != 0) dmut_detail::wait(this->remaining, left);
+		}
+
+		if (this->failure) std::rethrow_exception(std::exchange(this->failure, nullptr));
+	}
+
+public:
+
+	/**
+	 * \param threads the number of threads running every batch, including the
+	 *			thread running the batch, by default the number of cores.
+	 */
+	explicit thread_pool(const unsigned threads = std::max(1u, std::thread::hardware_concurrency()))
+		: shares(new share[std::max(1u, threads)])
+	{
+		try
+		{
+			for (unsigned i = 1; i < threads; ++i)
+				this->workers.emplace_back([this, i] { run_worker(i); });
+		}
+		catch (...)
+		{
+			stop();
+			throw;
+		}
+	}
+
+	thread_pool(const thread_pool& other) = delete;
+	thread_pool(thread_pool&& other) = delete;
+
+	~thread_pool() { stop(); }
+
+	thread_pool& operator=(const thread_pool& other) = delete;
+	thread_pool& operator=(thread_pool&& other) = delete;
+
+	/**
+	 * \brief	the number of threads running every batch, including the thread running the batch.
+	 */
+	std::size_t size() const noexcept { return this->workers.size() + 1; }
+
+	/**
+	 * \brief	calls fn(begin, end) for chunks of the indices in [0, n) in parallel,
+	 *			and returns once every chunk is done.
+	 * \param	n the number of indices.
+	 * \param	fn the function to call with every chunk, it is called concurrently
+	 *			by the threads of the pool.
+	 * \throws	the first exception thrown by fn, once the chunks being run are done,
+	 *			the chunks not started yet are skipped.
+	 */
+	template <typename F>
+	void run(const std::size_t n, F&& fn)
+	{
+		typedef typename std::remove_reference<F>::type function;
+		dispatch(n, [](void *fn_context, const std::size_t begin, const std::size_t end) {
+			(*static_cast<function*>(fn_context))(begin, end);
+		}, const_cast<void*>(static_cast<const void*>(std::addressof(fn))));
+	}
+};
+
+namespace dmut_detail
+{
+	/**
+	 * \brief	calls fn with every element of a random access range (or with the
+	 *			begin and end of every chunk of it) on the threads of a pool.
+	 */
+	template <typename Range, typename F>
+	void parallel_apply(Range& range, F& fn, thread_pool& pool)
+	{
+		typedef decltype(std::begin(range)) iterator;
+		static_assert(std::random_access_iterator<iterator>, "parallel operations require data that is a random access range");
+
+		const iterator first = std::begin(range);
+		pool.run(static_cast<std::size_t>(std::end(range) - first), [&fn, first](const std::size_t begin, const std::size_t end) {
+			const iterator chunk_begin = first + static_cast<std::ptrdiff_t>(begin);
+			const iterator chunk_end = first + static_cast<std::ptrdiff_t>(end);
+
+			if constexpr (std::is_invocable<F&, iterator, iterator>::value) fn(chunk_begin, chunk_end);
+			else for (iterator it = chunk_begin; it != chunk_end; ++it) fn(*it);
+		});
+	}
+}
+
+/**
+ * \brief	the contention profile of a lock, see profiled_lock.
+ *			durations are kept in histograms of nanoseconds, bucket i counts the
+ *			durations below 2^i nanoseconds which are not counted by bucket i - 1,
+ *			the last bucket counts every longer duration as well.
+ */
+struct lock_profile
+{
+	static constexpr std::size_t BUCKETS = 32;
+
+	typedef std::array<std::uint64_t, BUCKETS> histogram;
+
+	struct side
+	{
+		// successful acquires.
+		std::uint64_t acquires;
+
+		// acquires that found the lock taken, including failed try acquires.
+		std::uint64_t contended;
+
+		// the time acquires waited for the lock.
+		histogram wait;
+
+		// the time the lock was held, measured when it is released.
+		histogram hold;
+	};
+
+	side read;
+	side write;
+
+	// the most readers holding the lock at once.
+	std::uint64_t max_readers;
+};
+
+namespace dmut_detail
+{
+	inline std::uint64_t now_ns() noexcept
+	{
+		return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+
+	/**
+	 * \brief	the counters behind a lock_profile, updated without synchronizing with each other.
+	 */
+	class lock_counters
+	{
+		struct side
+		{
+			std::atomic<std::uint64_t> acquires{0};
+			std::atomic<std::uint64_t> contended{0};
+			std::atomic<std::uint64_t> wait[lock_profile::BUCKETS] = {};
+			std::atomic<std::uint64_t> hold[lock_profile::BUCKETS] = {};
+
+			void snapshot(lock_profile::side& to) const noexcept
+			{
+				to.acquires = this->acquires.load(std::memory_order_relaxed);
+				to.contended = this->contended.load(std::memory_order_relaxed);
+				for (std::size_t i = 0; i < lock_profile::BUCKETS; ++i)
+				{
+					to.wait[i] = this->wait[i].load(std::memory_order_relaxed);
+					to.hold[i] = this->hold[i].load(std::memory_order_relaxed);
+				}
+			}
+		};
+
+		static std::size_t bucket_of(const std::uint64_t ns) noexcept
+		{
+			std::size_t bucket = 0;
+			while (bucket < lock_profile::BUCKETS - 1 && (ns >> bucket) != 0) ++bucket;
+			return bucket;
+		}
+
+		static void add(std::atomic<std::uint64_t>& counter) noexcept { counter.fetch_add(1, std::memory_order_relaxed); }
+
+		side sides[2];
+
+		std::atomic<std::uint64_t> readers{0};
+		std::atomic<std::uint64_t> max_readers{0};
+
+	public:
+
+		void contended(const bool shared) noexcept { add(this->sides[shared].contended); }
+
+		void acquired(const bool shared, const std::uint64_t waited) noexcept
+		{
+			add(this->sides[shared].acquires);
+			add(this->sides[shared].wait[bucket_of(waited)]);
+
+			if (!shared) return;
+
+			const std::uint64_t inside = this->readers.fetch_add(1, std::memory_order_relaxed) + 1;
+			std::uint64_t most = this->max_readers.load(std::memory_order_relaxed);
+			while (most < inside && !this->max_readers.compare_exchange_weak(most, inside, std::memory_order_relaxed)) {}
+		}
+
+		/**
+		 * \param held how long the lock was held, unknown for a readers lock
+		 *			released by a different thread than the one that acquired it.
+		 */
+		void released(const bool shared, const std::optional<std::uint64_t> held) noexcept
+		{
+			if (shared) this->readers.fetch_sub(1, std::memory_order_relaxed);
+			if (held) add(this->sides[shared].hold[bucket_of(*held)]);
+		}
+
+		lock_profile snapshot() const noexcept
+		{
+			lock_profile profile;
+			this->sides[true].snapshot(profile.read);
+			this->sides[false].snapshot(profile.write);
+			profile.max_readers = this->max_readers.load(std::memory_order_relaxed);
+			return profile;
+		}
+	};
+
+	/**
+	 * \brief	the readers locks held by the calling thread, with the time they were
+	 *			acquired at, so the hold time of a readers lock can be measured
+	 *			without storing anything in the lock.
+	 */
+	class held_reads
+	{
+		static constexpr std::size_t ENTRIES = 8;
+
+		struct entry
+		{
+			const void *lock;
+			std::uint64_t since;
+		};
+
+		entry entries[ENTRIES];
+		std::size_t count = 0;
+
+	public:
+
+		static held_reads& own() noexcept
+		{
+			thread_local held_reads reads;
+			return reads;
+		}
+
+		// a lock held beyond the last entry is not timed.
+		void push(const void *lock, const std::uint64_t since) noexcept
+		{
+			if (this->count < ENTRIES) this->entries[this->count++] = entry{ lock, since };
+		}
+
+		std::optional<std::uint64_t> pop(const void *lock) noexcept
+		{
+			for (std::size_t i = this->count; i-- > 0;)
+			{
+				if (this->entries[i].lock != lock) continue;
+
+				const std::uint64_t since = this->entries[i].since;
+				for (std::size_t j = i + 1; j < this->count; ++j) this->entries[j - 1] = this->entries[j];
+				--this->count;
+				return since;
+			}
+
+			return std::nullopt;
+		}
+	};
+}
+
+/**
+ * \brief	the process wide registry of profiled locks, a lock registered under
+ *			a name (see profiled_lock::register_as and dmut::profile_as) can be
+ *			inspected or dumped from anywhere until it is destroyed.
+ */
+class dmut_registry
+{
+	template <typename>
+	friend class profiled_lock;
+
+	struct entry
+	{
+		std::string name;
+		const dmut_detail::lock_counters *counters;
+	};
+
+	mutable std::mutex guard;
+	std::vector<entry> entries;
+
+	dmut_registry() = default;
+
+	void add(std::string name, const dmut_detail::lock_counters& counters)
+	{
+		std::lock_guard<std::mutex> lock(this->guard);
+		for (entry& e : this->entries)
+		{
+			if (e.counters != &counters) continue;
+
+			e.name = std::move(name);
+			return;
+		}
+
+		this->entries.push_back(entry{ std::move(name), &counters });
+	}
+
+	void remove(const dmut_detail::lock_counters& counters) noexcept
+	{
+		std::lock_guard<std::mutex> lock(this->guard);
+		this->entries.erase(std::remove_if(this->entries.begin(), this->entries.end(),
+			[&counters](const entry& e) { return e.counters == &counters; }), this->entries.end());
+	}
+
+	static void dump_side(std::ostream& out, const std::string& name, const char *side, const lock_profile::side& profile)
+	{
+		out << name << ' ' << side << " acquires=" << profile.acquires << " contended=" << profile.contended;
+
+		const auto dump_histogram = [&out](const char *label, const lock_profile::histogram& histogram)
+		{
+			std::size_t used = histogram.size();
+			while (used > 0 && histogram[used - 1] == 0) --used;
+
+			out << ' ' << label << "=[";
+			for (std::size_t i = 0; i < used; ++i) out << (i == 0 ? "" : ",") << histogram[i];
+			out << ']';
+		};
+
+		dump_histogram("wait_ns_log2", profile.wait);
+		dump_histogram("hold_ns_log2", profile.hold);
+		out << '\n';
+	}
+
+public:
+
+	dmut_registry(const dmut_registry& other) = delete;
+	dmut_registry& operator=(const dmut_registry& other) = delete;
+
+	static dmut_registry& global()
+	{
+		// never destroyed, locks with static storage may unregister after it would have been.
+		static dmut_registry *registry = new dmut_registry();
+		return *registry;
+	}
+
+	/**
+	 * \brief	calls fn with the name and the current profile of every registered lock,
+	 *			locks cannot be registered or destroyed while fn runs.
+	 */
+	template <typename F>
+	void for_each(F&& fn) const
+	{
+		std::lock_guard<std::mutex> lock(this->guard);
+		for (const entry& e : this->entries) fn(e.name, e.counters->snapshot());
+	}
+
+	/**
+	 * \brief	writes the profile of every registered lock, a few lines per lock:
+	 *			"<name> write|read acquires=N contended=N wait_ns_log2=[...] hold_ns_log2=[...]"
+	 *			and "<name> max_readers=N", the histograms are cut after their last
+	 *			non empty bucket.
+	 */
+	void dump(std::ostream& out) const
+	{
+		for_each([&out](const std::string& name, const lock_profile& profile)
+		{
+			dump_side(out, name, "write", profile.write);
+			dump_side(out, name, "read", profile.read);
+			out << name << " max_readers=" << profile.max_readers << '\n';
+		});
+	}
+};
+
+/**
+ * \brief	Instrumentation on top of a readers-writer lock, recording how often the
+ *			lock is acquired, how often that had to wait and for how long,
+ *			and how long it is held, separately for readers and writers.
+ *			profiling is opt in, a dmut using any other lock contains none of it.
+ *
+ *			notes:
+ *
+ *			*	every acquire and release reads the steady clock and updates a few
+ *				counters on lines of their own, meant for finding the hot dmut in a
+ *				running service rather than for the hottest locks in a benchmark.
+ *
+ *			*	the hold time of a readers lock is measured by the thread that acquired it,
+ *				a readers lock released by another thread (or nested deeper than a few locks)
+ *				is counted without its hold time.
+ *
+ *			*	a lock registered under a name shows up in dmut_registry::global().
+ *
+ * \tparam Lock the underlying lock.
+ */
+template <typename Lock = reader_preferring_lock>
+class profiled_lock
+{
+	Lock lock_state;
+
+	// the time the current writer acquired the lock at, only accessed by the writer.
+	std::uint64_t write_since;
+
+	alignas(dmut_detail::CACHE_LINE) dmut_detail::lock_counters counters;
+
+	bool registered;
+
+	void acquired_write(const std::uint64_t started) noexcept
+	{
+		this->write_since = dmut_detail::now_ns();
+		this->counters.acquired(false, this->write_since - started);
+	}
+
+	void acquired_read(const std::uint64_t started) noexcept
+	{
+		const std::uint64_t since = dmut_detail::now_ns();
+		dmut_detail::held_reads::own().push(this, since);
+		this->counters.acquired(true, since - started);
+	}
+
+	void released_write() noexcept { this->counters.released(false, dmut_detail::now_ns() - this->write_since); }
+
+	void released_read() noexcept
+	{
+		const std::optional<std::uint64_t> since = dmut_detail::held_reads::own().pop(this);
+		this->counters.released(true, since ? std::optional<std::uint64_t>(dmut_detail::now_ns() - *since) : std::nullopt);
+	}
+
+	/**
+	 * \brief	acquires one side of the lock, trying first so uncontended acquires
+	 *			are told apart from those that wait.
+	 */
+	template <bool SHARED, typename Try, typename Wait>
+	bool acquire(Try&& try_acquire, Wait&& wait_acquire)
+	{
+		const std::uint64_t started = dmut_detail::now_ns();
+		if (!try_acquire())
+		{
+			this->counters.contended(SHARED);
+			if (!wait_acquire()) return false;
+		}
+
+		if constexpr (SHARED) acquired_read(started);
+		else acquired_write(started);
+		return true;
+	}
+
+public:
+
+	profiled_lock() noexcept : write_since(0), registered(false) {}
+	profiled_lock(const profiled_lock& other) = delete;
+	profiled_lock(profiled_lock&& other) = delete;
+
+	~profiled_lock()
+	{
+		if (this->registered) dmut_registry::global().remove(this->counters);
+	}
+
+	profiled_lock& operator=(const profiled_lock& other) = delete;
+	profiled_lock& operator=(profiled_lock&& other) = delete;
+
+	/**
+	 * \brief	registers the lock in the global registry under a name,
+	 *			registering again renames the lock.
+	 */
+	void register_as(std::string name)
+	{
+		dmut_registry::global().add(std::move(name), this->counters);
+		this->registered = true;
+	}
+
+	/**
+	 * \brief	the current profile of the lock.
+	 */
+	lock_profile profile() const noexcept { return this->counters.snapshot(); }
+
+	void lock()
+	{
+		acquire<false>([this] { return this->lock_state.try_lock(); }, [this] { this->lock_state.lock(); return true; });
+	}
+
+	bool try_lock()
+	{
+		return acquire<false>([this] { return this->lock_state.try_lock(); }, [] { return false; });
+	}
+
+	bool try_lock_until(const dmut_detail::deadline& until)
+	{
+		return acquire<false>([this] { return this->lock_state.try_lock(); }, [this, &until] { return this->lock_state.try_lock_until(until); });
+	}
+
+	void unlock() noexcept
+	{
+		released_write();
+		this->lock_state.unlock();
+	}
+
+	void lock_shared()
+	{
+		acquire<true>([this] { return this->lock_state.try_lock_shared(); }, [this] { this->lock_state.lock_shared(); return true; });
+	}
+
+	bool try_lock_shared()
+	{
+		return acquire<true>([this] { return this->lock_state.try_lock_shared(); }, [] { return false; });
+	}
+
+	bool try_lock_shared_until(const dmut_detail::deadline& until)
+	{
+		return acquire<true>([this] { return this->lock_state.try_lock_shared(); }, [this, &until] { return this->lock_state.try_lock_shared_until(until); });
+	}
+
+	void unlock_shared() noexcept
+	{
+		released_read();
+		this->lock_state.unlock_shared();
+	}
+
+	// upgradeable readers are profiled as readers.
+	void lock_upgrade()
+	{
+		acquire<true>([this] { return this->lock_state.try_lock_upgrade(); }, [this] { this->lock_state.lock_upgrade(); return true; });
+	}
+
+	bool try_lock_upgrade()
+	{
+		return acquire<true>([this] { return this->lock_state.try_lock_upgrade(); }, [] { return false; });
+	}
+
+	void unlock_upgrade() noexcept
+	{
+		released_read();
+		this->lock_state.unlock_upgrade();
+	}
+
+	void unlock_upgrade_and_lock()
+	{
+		released_read();
+
+		const std::uint64_t started = dmut_detail::now_ns();
+		this->lock_state.unlock_upgrade_and_lock();
+		acquired_write(started);
+	}
+
+	void unlock_and_lock_shared()
+	{
+		released_write();
+
+		const std::uint64_t started = dmut_detail::now_ns();
+		this->lock_state.unlock_and_lock_shared();
+		acquired_read(started);
+	}
+
+	void set_spin_budget(const std::uint32_t budget) noexcept { this->lock_state.set_spin_budget(budget); }
+};
+
+namespace dmut_detail
+{
+	/**
+	 * \brief	the reentrant locks held by the calling thread, along with how many
+	 *			times the thread entered each of them, see reentrant_lock.
+	 */
+	class held_locks
+	{
+		static constexpr std::size_t ENTRIES = 16;
+
+	public:
+
+		struct entry
+		{
+			const void *lock;
+			std::uint32_t reads;
+			std::uint32_t writes;
+
+			// whether the underlying lock is held exclusively, it stays held
+			// exclusively while readers nested in the writer are still held.
+			bool exclusive;
+		};
+
+	private:
+
+		entry entries[ENTRIES];
+		std::size_t count = 0;
+
+	public:
+
+		static held_locks& own() noexcept
+		{
+			thread_local held_locks locks;
+			return locks;
+		}
+
+		entry* find(const void *lock) noexcept
+		{
+			for (std::size_t i = this->count; i-- > 0;)
+			{
+				if (this->entries[i].lock == lock) return &this->entries[i];
+			}
+
+			return nullptr;
+		}
+
+		// a lock entered once the table is full is not tracked, entering it
+		// again acquires the underlying lock again.
+		void push(const void *lock, const bool exclusive) noexcept
+		{
+			if (this->count < ENTRIES) this->entries[this->count++] = entry{ lock, exclusive ? 0u : 1u, exclusive ? 1u : 0u, exclusive };
+		}
+
+		void remove(entry *held) noexcept
+		{
+			for (entry *it = held + 1; it != this->entries + this->count; ++it) *(it - 1) = *it;
+			--this->count;
+		}
+	};
+}
+
+/**
+ * \brief	A readers-writer lock that can be entered again by the thread holding it,
+ *			the nesting of every thread is tracked in a thread local table, so a
+ *			nested acquire is an increment of the table and touches no shared memory.
+ *
+ *			*	a thread holding a readers or a writers lock can acquire a readers lock
+ *				again, a readers lock nested in a writers lock reads the data the writer
+ *				wrote so far.
+ *
+ *			*	a thread holding a writers lock can acquire a writers lock again,
+ *				the lock is released once the outermost lock is.
+ *
+ *			*	a thread holding only a readers lock cannot acquire a writers lock,
+ *				since other readers may hold the lock as well, lock() throws a
+ *				std::system_error (resource_deadlock_would_occur) and try_lock() fails
+ *				instead of waiting forever.
+ *
+ *			notes:
+ *
+ *			*	a lock should be released by the thread that acquired it, since the
+ *				nesting is only known to that thread.
+ *
+ *			*	a dmut using a reentrant lock does not support read_optimistic and the
+ *				async acquires, and the upgradeable locks (publish, exchange, upgrade)
+ *				are not provided.
+ *
+ *			*	a thread tracks up to 16 locks at once, locks acquired beyond that
+ *				are acquired again when they are entered again.
+ *
+ * \tparam Lock the underlying lock.
+ */
+template <typename Lock = reader_preferring_lock>
+class reentrant_lock
+{
+	typedef dmut_detail::held_locks::entry entry;
+
+	Lock lock_state;
+
+	/**
+	 * \brief	enters the lock again if the calling thread holds it.
+	 * \return	whether the lock was entered, or an empty optional if the calling thread does
+	 *			not hold it, writers fail to enter locks the thread only holds as a reader,
+	 *			that is unless the underlying lock is still held exclusively by the thread
+	 *			(a readers lock taken while holding a writers lock which was released since).
+	 */
+	std::optional<bool> reenter(const bool exclusive) noexcept
+	{
+		entry *held = dmut_detail::held_locks::own().find(this);
+		if (held == nullptr) return std::nullopt;
+
+		if (!exclusive) ++held->reads;
+		else if (held->exclusive) ++held->writes;
+		else return false;
+
+		return true;
+	}
+
+	void entered(const bool exclusive) noexcept { dmut_detail::held_locks::own().push(this, exclusive); }
+
+	/**
+	 * \brief	leaves the lock, releasing the underlying lock if the lock is left
+	 *			as many times as it was entered.
+	 */
+	void leave(const bool exclusive) noexcept
+	{
+		dmut_detail::held_locks& locks = dmut_detail::held_locks::own();
+
+		entry *held = locks.find(this);
+		if (held == nullptr)
+		{
+			// the lock was acquired once the table was full.
+			if (exclusive) this->lock_state.unlock();
+			else this->lock_state.unlock_shared();
+			return;
+		}
+
+		if (exclusive) --held->writes;
+		else --held->reads;
+
+		if (held->reads != 0 || held->writes != 0) return;
+
+		const bool was_exclusive = held->exclusive;
+		locks.remove(held);
+
+		if (was_exclusive) this->lock_state.unlock();
+		else this->lock_state.unlock_shared();
+	}
+
+	template <typename Acquire>
+	bool acquire(const bool exclusive, Acquire&& acquire_lock)
+	{
+		if (const std::optional<bool> entered_again = reenter(exclusive)) return *entered_again;
+		if (!acquire_lock()) return false;
+
+		entered(exclusive);
+		return true;
+	}
+
+public:
+
+	static constexpr bool REENTRANT = true;
+
+	reentrant_lock() = default;
+	reentrant_lock(const reentrant_lock& other) = delete;
+	reentrant_lock(reentrant_lock&& other) = delete;
+
+	reentrant_lock& operator=(const reentrant_lock& other) = delete;
+	reentrant_lock& operator=(reentrant_lock&& other) = delete;
+
+	void lock()
+	{
+		if (!acquire(true, [this] { this->lock_state.lock(); return true; }))
+		{
+			throw std::system_error(std::make_error_code(std::errc::resource_deadlock_would_occur),
+				"reentrant_lock: a writers lock was requested by a thread holding a readers lock");
+		}
+	}
+
+	bool try_lock() { return acquire(true, [this] { return this->lock_state.try_lock(); }); }
+
+	bool try_lock_until(const dmut_detail::deadline& until)
+	{
+		return acquire(true, [this, &until] { return this->lock_state.try_lock_until(until); });
+	}
+
+	void unlock() noexcept { leave(true); }
+
+	void lock_shared() { acquire(false, [this] { this->lock_state.lock_shared(); return true; }); }
+
+	bool try_lock_shared() { return acquire(false, [this] { return this->lock_state.try_lock_shared(); }); }
+
+	bool try_lock_shared_until(const dmut_detail::deadline& until)
+	{
+		return acquire(false, [this, &until] { return this->lock_state.try_lock_shared_until(until); });
+	}
+
+	void unlock_shared() noexcept { leave(false); }
+
+	/**
+	 * \brief	turns one writers lock of the calling thread into a readers lock,
+	 *			the underlying lock is downgraded once no writers lock of the thread is left.
+	 */
+	void unlock_and_lock_shared()
+	{
+		entry *held = dmut_detail::held_locks::own().find(this);
+		if (held == nullptr)
+		{
+			this->lock_state.unlock_and_lock_shared();
+			return;
+		}
+
+		--held->writes;
+		++held->reads;
+		if (held->writes != 0) return;
+
+		this->lock_state.unlock_and_lock_shared();
+		held->exclusive = false;
+	}
+
+	void set_spin_budget(const std::uint32_t budget) noexcept { this->lock_state.set_spin_budget(budget); }
+};
+
+/**
+ * \brief	A lock that does nothing, for dmuts that are only ever used by a single
+ *			thread (batch tools sharing code with a threaded server for instance).
+ *			every acquire succeeds right away, so a dmut using it reads and writes
+ *			its data directly while the dlocks still tell readers from writers.
+ *			a dmut using a null_lock also skips the bookkeeping kept for other threads,
+ *			the version read by read_optimistic and the queue of suspended coroutines.
+ *			note: the data of such a dmut must not be accessed by several threads.
+ */
+class null_lock
+{
+public:
+
+	static constexpr bool SINGLE_THREADED = true;
+
+	constexpr void lock() noexcept {}
+	constexpr bool try_lock() noexcept { return true; }
+	constexpr bool try_lock_until(const dmut_detail::deadline&) noexcept { return true; }
+	constexpr void unlock() noexcept {}
+
+	constexpr void lock_shared() noexcept {}
+	constexpr bool try_lock_shared() noexcept { return true; }
+	constexpr bool try_lock_shared_until(const dmut_detail::deadline&) noexcept { return true; }
+	constexpr void unlock_shared() noexcept {}
+
+	constexpr void lock_upgrade() noexcept {}
+	constexpr bool try_lock_upgrade() noexcept { return true; }
+	constexpr void unlock_upgrade() noexcept {}
+
+	constexpr void unlock_upgrade_and_lock() noexcept {}
+	constexpr void unlock_and_lock_shared() noexcept {}
+
+	constexpr void set_spin_budget(std::uint32_t) noexcept {}
+};
+
+/**
+ * \brief	Instrumentation policy of a basic_dmut, the lock is used as is.
+ */
+struct no_instrumentation
+{
+	template <typename Lock>
+	using instrument = Lock;
+};
+
+/**
+ * \brief	Instrumentation policy of a basic_dmut, the lock is profiled, see profiled_lock.
+ */
+struct lock_profiling
+{
+	template <typename Lock>
+	using instrument = profiled_lock<Lock>;
+};
+
+/**
+ * \brief	A dmut put together from its policies, the instrumentation policy
+ *			decides what is layered on top of the lock policy.
+ *			with the default policies this is dmut<T> itself:
+ *			\code
+ *			basic_dmut<T>																// dmut<T>
+ *			basic_dmut<T, reader_preferring_lock, inline_storage<>, lock_profiling>	// dmut<T, profiled_lock<>>
+ *			basic_dmut<T, null_lock>													// single threaded
+ *			\endcode
+ * \tparam T The type of data that the mutex guards.
+ * \tparam LockPolicy The readers-writer lock used to guard the data, see dmut.
+ * \tparam StoragePolicy Where the data is stored, see inline_storage and pointer_storage.
+ * \tparam InstrumentationPolicy What wraps the lock, see no_instrumentation and lock_profiling.
+ */
+template <typename T, typename LockPolicy = reader_preferring_lock, typename StoragePolicy = inline_storage<>,
+	typename InstrumentationPolicy = no_instrumentation>
+using basic_dmut = dmut<T, typename InstrumentationPolicy::template instrument<LockPolicy>, StoragePolicy>;
+
+/**
+ * \brief	Data Oriented Mutex, The mutex holds the data and ensures
+ *			mutual exclusion in accessing it as apposed to std::mutex
+ *			which ensures mutual exclusion of code segments.
+ *			this mutex behaves more like a std::shared_mutex since
+ *			a readers lock (shared lock) can be acquired as well as
+ *			a writers lock (exclusive lock).
+ *
+ *			*	to acquire a writers lock use the lock() method,
+ *				use try_lock() if you wish for the method to return
+ *				upon failure.
+ *
+ *			*	to acquire a readers lock use the peek() method,
+ *				use try_peek() if you wish for the method to return
+ *				upon failure.
+ *
+ *			both operations return a dlock objects which acts as a unique_ptr
+ *			to the data, once the dlock is destroyed
+ *			(by going out of scope or using the unlock() method)
+ *			the lock is released and can be acquired by others.
+ *
+ *			notes:
+ *
+ *			*	it is recommended to use the make_dmut and new_dmut functions
+ *				in order to construct a dmut, but the constructors are available
+ *				and are better to use when for example the data the mutex should
+ *				protect has already been constructed.
+ *				
+ *			*	creating a dmut with type T[] is impossible, this is both a pain
+ *				to implement and should probably not be used, if you wish to create
+ *				a mutex that protects an array that is not dynamically allocated then
+ *				use std::array or some other safe wrapper.
+ *
+ *			*	the Lock type decides how readers and writers are synchronized,
+ *				any type providing the std::shared_mutex interface can be used,
+ *				the lock decides the scheduling between readers and writers,
+ *				see reader_preferring_lock (the default), writer_preferring_lock,
+ *				phase_fair_lock, big_reader_lock, cohort_lock (for numa machines),
+ *				priority_lock (serving waiters by priority), reentrant_lock
+ *				(which the thread holding it can acquire again) and null_lock
+ *				(for data used by a single thread), see also basic_dmut.
+ *
+ *			*	the lock state starts a cache line of its own, so dmuts placed
+ *				next to each other do not slow each other down, the data is stored
+ *				inside the dmut by default, and the layout given to inline_storage
+ *				decides whether it shares the line of the lock state,
+ *				see same_line_layout and separate_line_layout.
+ *			
+ * \tparam T The type of data that the mutex guards.
+ * \tparam Lock The readers-writer lock used to guard the data.
+ * \tparam Storage Where the data is stored, see inline_storage and pointer_storage.
+ */
+template <typename T, typename Lock, typename Storage>
+class dmut
+{
+	// the lock state, the version, the submitted operations and the write queue
+	// share the first line of the dmut, followed by the data.
+	typedef dmut_detail::storage_traits<Storage, T, sizeof(Lock) + sizeof(std::atomic<std::uint32_t>) +
+		sizeof(std::atomic<dmut_detail::submitted_op<T>*>) + sizeof(std::atomic<dmut_detail::write_queue<T>*>) +
+		sizeof(std::atomic<dmut_detail::async_queue*>) + sizeof(std::atomic<dmut_detail::condition_queue*>)> storage;
+
+	// a lock used by a single thread (see null_lock) needs none of the bookkeeping kept
+	// for other threads, nor a cache line of its own.
+	static constexpr bool SINGLE_THREADED = requires { requires Lock::SINGLE_THREADED; };
+
+	// ensures that when write access is needed only one thread
+	// can hold a write lock and no read lock can be held,
+	// while any number of read locks can be held otherwise.
+	alignas(SINGLE_THREADED ? alignof(Lock) : dmut_detail::CACHE_LINE) Lock lock_state;
+
+	// seqlock style version of the data, odd while a writer holds the lock.
+	// only maintained for types that can be read optimistically, and not when
+	// writers elide the lock since every writer would conflict on the version,
+	// nor when writers can be nested in each other, nor by a single thread.
+	std::atomic<std::uint32_t> version{0};
+
+	static constexpr bool VERSIONED = std::is_trivially_copyable<T>::value && !SINGLE_THREADED &&
+		!requires { requires Lock::ELIDES_WRITERS; } && !requires { requires Lock::REENTRANT; };
+
+	// the async acquires try the lock on behalf of waiting coroutines,
+	// which a reentrant lock would grant as the releasing thread.
+	static constexpr bool ASYNC = !requires { requires Lock::REENTRANT; };
+
+	// publish replaces the data while readers hold the lock,
+	// so a readers lock keeps the data it found when it was acquired (see dlock).
+	static constexpr bool PINS_READERS = storage::OWNS_POINTER;
+
+	// operations submitted while the writers lock was held (see submit),
+	// a stack which is drained by the writer before releasing the lock.
+	std::atomic<dmut_detail::submitted_op<T>*> submitted{nullptr};
+
+	// the number of backoff rounds a submitting thread waits for its operation
+	// to be run by the lock holder before blocking on the lock itself.
+	static constexpr unsigned SUBMIT_ROUNDS = 10;
+
+	// the number of times a writer drains the submitted operations before releasing
+	// the lock, operations submitted later are run by their own threads.
+	static constexpr unsigned DRAIN_PASSES = 4;
+
+	// writes queued without waiting for them to run (see enqueue_write),
+	// null until the first write is queued.
+	std::atomic<dmut_detail::write_queue<T>*> queue{nullptr};
+
+	// coroutines waiting for a lock (see lock_async),
+	// null until the first coroutine has to wait.
+	std::atomic<dmut_detail::async_queue*> async_waiters{nullptr};
+
+	// threads waiting for the data to satisfy a predicate (see dlock::wait),
+	// null until the first thread has to wait.
+	std::atomic<dmut_detail::condition_queue*> conditions{nullptr};
+
+	// the data itself or a pointer to it, depending on the storage policy.
+	typename storage::holder data;
+
+	// the number of optimistic reads attempted before falling back to a readers lock.
+	static constexpr unsigned OPTIMISTIC_ATTEMPTS = 16;
+
+	template <typename, typename, LOCK_TYPE>
+	friend class dlock;
+	friend dmut_detail::access;
+
+	template <typename, bool>
+	friend class dmut_detail::lockable;
+
+	/**
+	 * \brief	marks the data as being written, should be called
+	 *			right after a writers lock is acquired.
+	 */
+	void begin_write() noexcept
+	{
+		if constexpr (VERSIONED)
+		{
+			// only the writer modifies the version, no read-modify-write is needed.
+			this->version.store(this->version.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+		}
+	}
+
+	/**
+	 * \brief	marks the data as stable again, should be called
+	 *			right before a writers lock is released.
+	 */
+	void end_write() noexcept
+	{
+		if constexpr (VERSIONED)
+			this->version.store(this->version.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	
+    /**
+	 * \brief	callback for releasing locks on this dmut.
+	 *			should be called whenever a lock expires.
+	 * \tparam	TYPE the type of the expiring lock.
+	 */
+	template <LOCK_TYPE TYPE>
+	void on_release() noexcept
+	{
+		if constexpr (TYPE == WRITER_LOCK)
+		{
+			run_submitted();
+			run_queued();
+
+			// the writer is the only one left who could refer to data replaced by publish.
+			if constexpr (storage::OWNS_POINTER) this->data.reclaim();
+
+			notify_conditions();
+			end_write();
+			this->lock_state.unlock();
+		}
+		else if constexpr (TYPE == READER_LOCK) this->lock_state.unlock_shared();
+		else if constexpr (TYPE == UPGRADE_LOCK) this->lock_state.unlock_upgrade();
+
+		resume_async();
+	}
+
+	/**
+	 * \brief	tries to acquire the lock on behalf of a suspended coroutine.
+	 */
+	bool try_acquire_async(const bool shared) noexcept
+	{
+		return shared ? this->lock_state.try_lock_shared() : this->lock_state.try_lock();
+	}
+
+	/**
+	 * \brief	the queue of suspended coroutines, created if it does not exist yet.
+	 */
+	dmut_detail::async_queue& async_queue()
+	{
+		dmut_detail::async_queue *waiters = this->async_waiters.load(std::memory_order_acquire);
+		if (waiters != nullptr) return *waiters;
+
+		std::unique_ptr<dmut_detail::async_queue> created(new dmut_detail::async_queue());
+		if (this->async_waiters.compare_exchange_strong(waiters, created.get(), std::memory_order_acq_rel))
+			return *created.release();
+
+		// another thread created the queue first.
+		return *waiters;
+	}
+
+	/**
+	 * \brief	queues a coroutine waiting for the lock, unless the lock
+	 *			can be acquired by now.
+	 * \return	whether the coroutine was queued and should stay suspended.
+	 */
+	bool suspend_async(dmut_detail::async_waiter& waiter)
+	{
+		dmut_detail::async_queue& waiters = async_queue();
+		std::lock_guard<std::mutex> guard(waiters.guard);
+
+		// a thread releasing the lock from now on sees the waiter, and a thread
+		// that released it before is seen by the next attempt to acquire it.
+		waiters.waiting.fetch_add(1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		if (try_acquire_async(waiter.shared))
+		{
+			waiters.waiting.fetch_sub(1, std::memory_order_relaxed);
+			return false;
+		}
+
+		if (waiters.tail != nullptr) waiters.tail->next = &waiter;
+		else waiters.head = &waiter;
+		waiters.tail = &waiter;
+		return true;
+	}
+
+	/**
+	 * \brief	grants the lock to the coroutines waiting for it, in the order they
+	 *			suspended, for as long as the lock can be acquired on their behalf,
+	 *			should be called right after a lock is released.
+	 */
+	void resume_async() noexcept
+	{
+		// every acquire of a single threaded lock succeeds, no coroutine ever waits.
+		if constexpr (SINGLE_THREADED) return;
+
+		dmut_detail::async_queue *waiters = this->async_waiters.load(std::memory_order_acquire);
+		if (waiters == nullptr) return;
+
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (waiters->waiting.load(std::memory_order_relaxed) == 0) return;
+
+		dmut_detail::async_waiter *granted = nullptr;
+		dmut_detail::async_waiter **last = &granted;
+		{
+			std::lock_guard<std::mutex> guard(waiters->guard);
+			while (waiters->head != nullptr && try_acquire_async(waiters->head->shared))
+			{
+				*last = std::exchange(waiters->head, waiters->head->next);
+				last = &(*last)->next;
+				*last = nullptr;
+				waiters->waiting.fetch_sub(1, std::memory_order_relaxed);
+			}
+
+			if (waiters->head == nullptr) waiters->tail = nullptr;
+		}
+
+		// the coroutines are resumed outside of the queue, they may acquire locks once resumed.
+		while (granted != nullptr)
+		{
+			dmut_detail::async_waiter *next = granted->next;
+			granted->resume(granted);
+			granted = next;
+		}
+	}
+
+	/**
+	 * \brief	should be called once an attempt to acquire the lock failed, the attempt
+	 *			may have kept out the coroutines acquiring the lock at the same time
+	 *			(a writer announcing itself before backing off, see big_reader_lock and
+	 *			phase_fair_lock, or a pending writer withdrawn by a timed acquire),
+	 *			so the lock is granted to the coroutines that missed it meanwhile.
+	 */
+	void on_failed_acquire() noexcept { resume_async(); }
+
+	/**
+	 * \brief	holds the writers side of the lock for an operation of the dmut itself,
+	 *			the data is marked as being written for as long as the guard is held,
+	 *			since the operation may write it in place (see read_optimistic),
+	 *			and releasing it resumes the coroutines waiting for the lock.
+	 */
+	class internal_guard
+	{
+		dmut& owner;
+
+	public:
+
+		explicit internal_guard(dmut& owner) : owner(owner)
+		{
+			owner.lock_state.lock();
+			owner.begin_write();
+		}
+
+		internal_guard(dmut& owner, std::adopt_lock_t) noexcept : owner(owner) { owner.begin_write(); }
+
+		internal_guard(const internal_guard& other) = delete;
+		internal_guard& operator=(const internal_guard& other) = delete;
+
+		~internal_guard()
+		{
+			this->owner.end_write();
+			this->owner.lock_state.unlock();
+			this->owner.resume_async();
+		}
+	};
+
+	/**
+	 * \brief	the queue of threads waiting for a predicate, created if it does not exist yet.
+	 */
+	dmut_detail::condition_queue& condition_queue()
+	{
+		dmut_detail::condition_queue *waiters = this->conditions.load(std::memory_order_acquire);
+		if (waiters != nullptr) return *waiters;
+
+		std::unique_ptr<dmut_detail::condition_queue> created(new dmut_detail::condition_queue());
+		if (this->conditions.compare_exchange_strong(waiters, created.get(), std::memory_order_acq_rel))
+			return *created.release();
+
+		// another thread created the queue first.
+		return *waiters;
+	}
+
+	template <typename Pred>
+	static bool check_predicate(void *predicate, const void *data)
+	{
+		return (*static_cast<Pred*>(predicate))(*static_cast<const T*>(data));
+	}
+
+	/**
+	 * \brief	wakes the threads waiting for a predicate the data satisfies, only the first
+	 *			of the waiting writers is woken since it may change the data once again,
+	 *			should be called by a writer right before it releases the lock.
+	 */
+	void notify_conditions() noexcept
+	{
+		dmut_detail::condition_queue *waiters = this->conditions.load(std::memory_order_acquire);
+
+		// waiters are queued while holding a lock, so the writer holding the lock sees them.
+		if (waiters == nullptr || waiters->waiting.load(std::memory_order_relaxed) == 0) return;
+
+		const T *current = this->data.get();
+		bool writer_woken = false;
+
+		std::lock_guard<std::mutex> guard(waiters->guard);
+		for (dmut_detail::condition_waiter *waiter = waiters->head; waiter != nullptr;)
+		{
+			dmut_detail::condition_waiter *next = waiter->next;
+			if (!(waiter->exclusive && writer_woken))
+			{
+				bool satisfied;
+				try
+				{
+					satisfied = waiter->check(waiter->predicate, current);
+				}
+				catch (...)
+				{
+					// the waiter evaluates the predicate itself once woken, and gets the exception.
+					satisfied = true;
+				}
+
+				if (satisfied)
+				{
+					writer_woken = writer_woken || waiter->exclusive;
+					waiters->wake(*waiter);
+				}
+			}
+
+			waiter = next;
+		}
+	}
+
+	/**
+	 * \brief	waits for the data to satisfy a predicate while holding a lock of the given type,
+	 *			releasing the lock while waiting, see dlock::wait.
+	 * \param	until the deadline for the wait or null for no deadline.
+	 * \return	whether the predicate is satisfied, the lock is held again either way.
+	 */
+	template <LOCK_TYPE TYPE, typename Pred>
+	bool wait_on(Pred& pred, const dmut_detail::deadline *until)
+	{
+		static_assert(TYPE != UPGRADE_LOCK, "waiting is not available for upgradeable readers locks");
+		static_assert(!SINGLE_THREADED, "waiting is not available with a single threaded lock, no one else could change the data");
+
+		if (pred(std::as_const(*this->data.get()))) return true;
+
+		dmut_detail::condition_queue& waiters = condition_queue();
+		dmut_detail::condition_waiter waiter(&check_predicate<Pred>, std::addressof(pred), TYPE == WRITER_LOCK);
+
+		do
+		{
+			{
+				std::lock_guard<std::mutex> guard(waiters.guard);
+				waiters.link(waiter);
+			}
+
+			// a writer changing the data from now on sees the waiter.
+			on_release<TYPE>();
+
+			bool expired = false;
+			while (waiter.woken.load(std::memory_order_acquire) == 0 && !expired)
+				expired = !dmut_detail::wait(waiter.woken, 0, until);
+
+			{
+				std::lock_guard<std::mutex> guard(waiters.guard);
+				waiters.unlink(waiter);
+			}
+
+			if constexpr (TYPE == WRITER_LOCK)
+			{
+				this->lock_state.lock();
+				begin_write();
+			}
+			else this->lock_state.lock_shared();
+
+			if (expired) return pred(std::as_const(*this->data.get()));
+		}
+		while (!pred(std::as_const(*this->data.get())));
+
+		return true;
+	}
+
+	/**
+	 * \brief	the awaitable returned by lock_async and peek_async, acquiring a lock
+	 *			for the awaiting coroutine or suspending it until the lock is granted.
+	 * \tparam	TYPE the type of lock to acquire.
+	 * \tparam	Executor resumes the coroutine once it is granted the lock.
+	 */
+	template <LOCK_TYPE TYPE, typename Executor>
+	class async_acquire : dmut_detail::async_waiter
+	{
+		dmut& owner;
+		Executor executor;
+
+		static void resume_waiter(dmut_detail::async_waiter *waiter) noexcept
+		{
+			async_acquire *self = static_cast<async_acquire*>(waiter);
+
+			// the coroutine may be done with the awaitable as soon as it is resumed.
+			const std::coroutine_handle<> handle = self->handle;
+			Executor executor(std::move(self->executor));
+			executor(handle);
+		}
+
+	public:
+
+		async_acquire(dmut& owner, Executor executor)
+			: async_waiter(&async_acquire::resume_waiter, TYPE == READER_LOCK), owner(owner), executor(std::move(executor)) {}
+
+		async_acquire(const async_acquire& other) = delete;
+		async_acquire& operator=(const async_acquire& other) = delete;
+
+		bool await_ready() noexcept
+		{
+			if (this->owner.try_acquire_async(this->shared)) return true;
+
+			this->owner.on_failed_acquire();
+			return false;
+		}
+
+		bool await_suspend(const std::coroutine_handle<> awaiting)
+		{
+			this->handle = awaiting;
+			return this->owner.suspend_async(*this);
+		}
+
+		auto await_resume() noexcept
+		{
+			if constexpr (TYPE == WRITER_LOCK) return this->owner.adopt_lock();
+			else return this->owner.adopt_peek();
+		}
+	};
+
+	/**
+	 * \brief	runs the operations submitted to the dmut, in the order they were submitted,
+	 *			should be called while holding the writers lock.
+	 */
+	void run_submitted() noexcept
+	{
+		// most releases find nothing submitted, a load keeps them from taking the line exclusively.
+		// an operation missed by the load is run by its submitter, which takes the lock after publishing it.
+		if (this->submitted.load(std::memory_order_relaxed) == nullptr) return;
+
+		for (unsigned pass = 0; pass < DRAIN_PASSES; ++pass)
+		{
+			dmut_detail::submitted_op<T> *op = this->submitted.exchange(nullptr, std::memory_order_acquire);
+			if (op == nullptr) return;
+
+			// the stack holds the latest operation first.
+			dmut_detail::submitted_op<T> *ordered = nullptr;
+			while (op != nullptr) ordered = std::exchange(op, std::exchange(op->next, ordered));
+
+			while (ordered != nullptr)
+			{
+				// the submitting thread might leave as soon as the operation is done.
+				dmut_detail::submitted_op<T> *next = ordered->next;
+				ordered->run(ordered, *this->data.get());
+				ordered->done.store(true, std::memory_order_release);
+				ordered = next;
+			}
+		}
+	}
+
+	/**
+	 * \brief	runs the queued writes in the order they were queued, skipping keyed
+	 *			writes superseded by a later write of the same key,
+	 *			should be called while holding the writers lock.
+	 */
+	void run_queued() noexcept
+	{
+		dmut_detail::write_queue<T> *pending = this->queue.load(std::memory_order_acquire);
+		if (pending == nullptr) return;
+
+		dmut_detail::queued_op<T> *op = pending->head.exchange(nullptr, std::memory_order_acquire);
+		if (op == nullptr) return;
+
+		// the stack is walked from the latest write, so the first write of a key
+		// encountered is the one superseding the rest.
+		dmut_detail::queued_op<T> *ordered = nullptr;
+		try
+		{
+			pending->seen.clear();
+			while (op != nullptr)
+			{
+				if (op->keyed) op->superseded = !pending->seen.insert(op->key).second;
+				ordered = std::exchange(op, std::exchange(op->next, ordered));
+			}
+		}
+		catch (...)
+		{
+			// without memory to coalesce, every remaining write is run.
+			while (op != nullptr) ordered = std::exchange(op, std::exchange(op->next, ordered));
+		}
+
+		while (ordered != nullptr)
+		{
+			dmut_detail::queued_op<T> *next = ordered->next;
+			ordered->run(ordered, ordered->superseded ? nullptr : this->data.get());
+			ordered = next;
+		}
+	}
+
+	/**
+	 * \brief	the write queue of the dmut, created if it does not exist yet.
+	 */
+	dmut_detail::write_queue<T>& write_queue()
+	{
+		dmut_detail::write_queue<T> *pending = this->queue.load(std::memory_order_acquire);
+		if (pending != nullptr) return *pending;
+
+		std::unique_ptr<dmut_detail::write_queue<T>> created(new dmut_detail::write_queue<T>());
+		if (this->queue.compare_exchange_strong(pending, created.get(), std::memory_order_acq_rel))
+			return *created.release();
+
+		// another thread created the queue first.
+		return *pending;
+	}
+
+	/**
+	 * \brief	queues a write, the write is run by the next writer releasing its lock.
+	 */
+	template <typename F>
+	void push_write(F&& fn, const std::size_t key, const bool keyed)
+	{
+		dmut_detail::write_queue<T>& pending = write_queue();
+		dmut_detail::queued_op<T> *op = new dmut_detail::queued_call<T, typename std::decay<F>::type>(std::forward<F>(fn), key, keyed);
+
+		op->next = pending.head.load(std::memory_order_relaxed);
+		while (!pending.head.compare_exchange_weak(op->next, op, std::memory_order_seq_cst, std::memory_order_relaxed)) {}
+
+		if (pending.draining.load(std::memory_order_relaxed) && pending.signal.exchange(1) == 0)
+			dmut_detail::wake_one(pending.signal);
+	}
+
+	/**
+	 * \brief	the background drainer, locks the dmut whenever writes are queued.
+	 */
+	void drain_writes(dmut_detail::write_queue<T>& pending) noexcept
+	{
+		for (;;)
+		{
+			pending.signal.store(0);
+			if (!pending.draining.load()) return;
+
+			if (pending.head.load() == nullptr)
+			{
+				dmut_detail::wait(pending.signal, 0);
+				continue;
+			}
+
+			this->lock_state.lock();
+			begin_write();
+			on_release<WRITER_LOCK>();
+		}
+	}
+
+	/**
+	 * \brief	hands the data of a dmut being moved, whose lock is held,
+	 *			its queued writes are run first since they do not move along.
+	 */
+	static typename storage::holder&& moved_data(dmut& other) noexcept
+	{
+		other.run_queued();
+		return std::move(other.data);
+	}
+
+	/**
+	 * \brief	the data the locks issued by this dmut refer to.
+	 */
+	T* locked_data() noexcept { return this->data.get(); }
+
+	/**
+	 * \brief	releases a lock held by the dmut itself once the scope
+	 *			it was acquired in is left, see with_lock.
+	 */
+	template <LOCK_TYPE TYPE>
+	struct scoped_release
+	{
+		dmut& owner;
+
+		~scoped_release() { this->owner.template on_release<TYPE>(); }
+	};
+
+	/**
+	 * \brief	moves the data of a dmut whose lock is held by the guard.
+	 */
+	dmut(dmut&& other, const internal_guard&) : data(moved_data(other)) {}
+
+	/**
+	 * \brief	issues a writers lock on the data, the lock state must
+	 *			already be held by the caller.
+	 */
+	dlock<T, dmut> adopt_lock() noexcept
+	{
+		begin_write();
+		return dlock<T, dmut>(this);
+	}
+
+	/**
+	 * \brief	issues a readers lock on the data, the readers side of the
+	 *			lock state must already be held by the caller.
+	 */
+	dlock<const T, dmut> adopt_peek() noexcept { return dlock<const T, dmut>(this); }
+
+public:
+
+	typedef T value_type;
+	typedef Lock lock_type;
+	typedef Storage storage_type;
+
+	typedef dlock<T, dmut> write_lock;
+	typedef dlock<const T, dmut> read_lock;
+	typedef dlock<const T, dmut, UPGRADE_LOCK> upgrade_lock;
+
+	explicit dmut(T&& value) : data(std::in_place, std::move(value)) {}
+	explicit dmut(const T& value) : data(std::in_place, value) {}
+
+	/**
+	 * \brief	constructs a dmut, constructing the data it guards in its final storage.
+	 * \param	args the parameters required to construct the data.
+	 */
+	template <typename ...U>
+	explicit dmut(std::in_place_t, U&& ...args) : data(std::in_place, std::forward<U>(args)...) {}
+
+	/**
+	 * \brief	constructs a dmut, constructing the data it guards in its final storage
+	 *			with uses-allocator construction, the data receives the allocator
+	 *			if it uses one, with allocated_storage the data is allocated by it as well.
+	 *			note: this is not available with pointer_storage.
+	 * \param	allocator the allocator.
+	 * \param	args the parameters required to construct the data.
+	 */
+	template <typename Allocator, typename ...U>
+	dmut(std::allocator_arg_t, const Allocator& allocator, U&& ...args) requires (!storage::OWNS_POINTER)
+		: data(std::allocator_arg, allocator, std::forward<U>(args)...) {}
+
+	/**
+	 * \brief	constructs a dmut guarding data allocated on the heap,
+	 *			the dmut takes ownership of the data and deletes it once destroyed.
+	 * \param	value_ptr the data, allocated with new.
+	 */
+	explicit dmut(T *value_ptr) requires (storage::OWNS_POINTER) : data(value_ptr) {}
+    dmut() : dmut(std::in_place) {}
+    dmut(const dmut& other) = delete;
+
+	/**
+	 * \brief	constructs a dmut by moving some dmut into a new one.
+	 *			note: this constructor requires a writers lock on the
+	 *			dmut being moved.
+	 * \param	other the dmut being moved.
+	 */
+    dmut(dmut&& other) noexcept(std::is_nothrow_move_constructible<typename storage::holder>::value)
+		// no other thread can know of the dmut being constructed,
+		// so only the dmut being moved has to be locked.
+		: dmut(std::move(other), internal_guard(other)) {}
+
+    ~dmut() 
+    {
+		// the background drainer might be waiting for the lock.
+		stop_write_drainer();
+
+    	// this will ensure that the mutex cannot be destroyed while
+    	// someone holds a lock on its data.
+		std::lock_guard<Lock> guard(this->lock_state);
+
+		// no coroutine nor thread can be waiting for a dmut being destroyed.
+		delete this->async_waiters.load(std::memory_order_relaxed);
+		delete this->conditions.load(std::memory_order_relaxed);
+
+		// writes still queued are run before the data is gone.
+		dmut_detail::write_queue<T> *pending = this->queue.load(std::memory_order_relaxed);
+		if (pending == nullptr) return;
+
+		run_queued();
+		delete pending;
+    }
+
+	dmut& operator=(const dmut& other) = delete;
+
+    /**
+	 * \brief	moves some dmut into this one.
+	 *			note: this operation requires a writers lock on both dmuts,
+	 *			thus the method may block for a long time if both dmuts are active.
+	 * \param	other the dmut being moved into this one.
+	 * \return	a reference to this dmut.
+	 */
+	dmut& operator=(dmut&& other) noexcept(std::is_nothrow_move_assignable<typename storage::holder>::value)
+	{
+		if (this == &other) return *this;
+
+		// two threads moving two dmuts into each other lock them in opposite
+		// orders, both locks are acquired at once to avoid deadlocking.
+		dmut_detail::lockable<dmut, false> this_lockable(*this);
+		dmut_detail::lockable<dmut, false> other_lockable(other);
+		dmut_detail::lock_all(this_lockable, other_lockable);
+
+		//both mutexes will unlock when the methods returns.
+		const internal_guard this_guard(*this, std::adopt_lock);
+		const internal_guard other_guard(other, std::adopt_lock);
+		
+		run_queued();
+		this->data = moved_data(other);
+		notify_conditions();
+		return *this;
+	}
+
+	
+    /**
+     * \brief	requests a writers lock on the data.
+     *			if someone else is already holding some lock on this data
+     *			this method will wait until the lock is available.
+     *			for non blocking requests see 'try_lock'.
+     * \return the lock on the data with ability to read and write to the underlying memory.
+     * 
+     */
+    dlock<T, dmut> lock()
+    {
+		this->lock_state.lock();
+		begin_write();
+		return dlock<T, dmut>(this);
+	}
+	
+    /**
+	 * \brief	requests a writers lock on the data.
+	 *			if someone else is already holding some lock on this data
+	 *			the lock will not be acquired and the method will return.
+	 * \return a pair of bool and dlock, the bool represents whether or not
+	 *			the lock was acquired and the dlock is the lock itself.
+	 *			in case the lock is not acquired a dlock pointing to null will be returned.
+	 */
+	std::pair<bool, dlock<T, dmut>> try_lock()
+	{
+		if (this->lock_state.try_lock())
+		{
+			begin_write();
+			return std::make_pair(true, dlock<T, dmut>(this));
+		}
+
+		on_failed_acquire();
+		return std::make_pair(false, dlock<T, dmut>()); 
+	}
+
+
+    /**
+	 * \brief	requests a readers lock on the data.
+	 *			if someone else is holding a writers lock on the data
+	 *			this method will wait until the lock is released.
+	 *			for non blocking requests see 'try_peek'.
+	 * \return the lock on the data as const, meaning the data can only be read.
+	 */
+	dlock<const T, dmut> peek()
+	{
+		this->lock_state.lock_shared();
+		return dlock<const T, dmut>(this);
+	}
+
+    /**
+	 * \brief	requests a readers lock on the data.
+	 *			if someone else is holding a writers lock on the data
+	 *			the lock will not be acquired and the method will return.
+	 * \return a pair of bool and dlock, the bool represents whether or not the lock
+	 *			was acquired and the dlock is the lock itself.
+	 *			in case the lock cannot be acquired a dlock pointing to null will re returned.
+	 */
+	std::pair<bool, dlock<const T, dmut>> try_peek()
+	{
+		if (this->lock_state.try_lock_shared())
+			return std::make_pair(true, dlock<const T, dmut>(this));
+
+		on_failed_acquire();
+		return std::make_pair(false, dlock<const T, dmut>());
+	}
+
+	/**
+	 * \brief	requests a writers lock on the data, waiting until the lock
+	 *			is available or the deadline passes.
+	 *			note: this requires a Lock supporting timed acquires.
+	 * \param	until the deadline of the request.
+	 * \return the lock on the data, or an empty optional if the deadline
+	 *			passed before the lock could be acquired.
+	 */
+	template <typename Clock, typename Duration>
+	std::optional<dlock<T, dmut>> try_lock_until(const std::chrono::time_point<Clock, Duration>& until)
+	{
+		if (!this->lock_state.try_lock_until(dmut_detail::to_deadline(until)))
+		{
+			on_failed_acquire();
+			return std::nullopt;
+		}
+
+		begin_write();
+		return std::optional<dlock<T, dmut>>(std::in_place, this);
+	}
+
+	/**
+	 * \brief	requests a writers lock on the data, waiting until the lock
+	 *			is available or the timeout expires.
+	 *			note: this requires a Lock supporting timed acquires.
+	 * \param	timeout the longest time to wait for the lock.
+	 * \return the lock on the data, or an empty optional if the timeout
+	 *			expired before the lock could be acquired.
+	 */
+	template <typename Rep, typename Period>
+	std::optional<dlock<T, dmut>> try_lock_for(const std::chrono::duration<Rep, Period>& timeout)
+	{
+		return try_lock_until(std::chrono::steady_clock::now() + timeout);
+	}
+
+	/**
+	 * \brief	requests a readers lock on the data, waiting until the lock
+	 *			is available or the deadline passes.
+	 *			note: this requires a Lock supporting timed acquires.
+	 * \param	until the deadline of the request.
+	 * \return the lock on the data as const, or an empty optional if the deadline
+	 *			passed before the lock could be acquired.
+	 */
+	template <typename Clock, typename Duration>
+	std::optional<dlock<const T, dmut>> try_peek_until(const std::chrono::time_point<Clock, Duration>& until)
+	{
+		if (!this->lock_state.try_lock_shared_until(dmut_detail::to_deadline(until)))
+		{
+			on_failed_acquire();
+			return std::nullopt;
+		}
+
+		return std::optional<dlock<const T, dmut>>(std::in_place, this);
+	}
+
+	/**
+	 * \brief	requests a readers lock on the data, waiting until the lock
+	 *			is available or the timeout expires.
+	 *			note: this requires a Lock supporting timed acquires.
+	 * \param	timeout the longest time to wait for the lock.
+	 * \return the lock on the data as const, or an empty optional if the timeout
+	 *			expired before the lock could be acquired.
+	 */
+	template <typename Rep, typename Period>
+	std::optional<dlock<const T, dmut>> try_peek_for(const std::chrono::duration<Rep, Period>& timeout)
+	{
+		return try_peek_until(std::chrono::steady_clock::now() + timeout);
+	}
+
+	/**
+	 * \brief	requests a writers lock on the data, ahead of the requests of lower priority
+	 *			waiting for it.
+	 *			note: this requires a Lock supporting priorities, such as priority_lock.
+	 * \param	priority requests of higher priority are served first.
+	 * \return the lock on the data with ability to read and write to the underlying memory.
+	 */
+	dlock<T, dmut> lock(const unsigned priority)
+	{
+		this->lock_state.lock(priority);
+		begin_write();
+		return dlock<T, dmut>(this);
+	}
+
+	/**
+	 * \brief	requests a readers lock on the data, ahead of the requests of lower priority
+	 *			waiting for it.
+	 *			note: this requires a Lock supporting priorities, such as priority_lock.
+	 * \param	priority requests of higher priority are served first.
+	 * \return the lock on the data as const, meaning the data can only be read.
+	 */
+	dlock<const T, dmut> peek(const unsigned priority)
+	{
+		this->lock_state.lock_shared(priority);
+		return dlock<const T, dmut>(this);
+	}
+
+	/**
+	 * \brief	requests a writers lock on the data, ahead of the requests waiting for it
+	 *			with a later deadline (earliest deadline first).
+	 *			unlike try_lock_until the request does not expire, the deadline only
+	 *			decides its place among the waiting requests.
+	 *			note: this requires a Lock supporting priorities, such as priority_lock.
+	 * \param	due the deadline of the request.
+	 * \return the lock on the data with ability to read and write to the underlying memory.
+	 */
+	template <typename Clock, typename Duration>
+	dlock<T, dmut> lock_until(const std::chrono::time_point<Clock, Duration>& due)
+	{
+		this->lock_state.lock(Lock::DEFAULT_PRIORITY, dmut_detail::to_deadline(due));
+		begin_write();
+		return dlock<T, dmut>(this);
+	}
+
+	/**
+	 * \brief	requests a readers lock on the data, ahead of the requests waiting for it
+	 *			with a later deadline, see lock_until.
+	 *			note: this requires a Lock supporting priorities, such as priority_lock.
+	 * \param	due the deadline of the request.
+	 * \return the lock on the data as const, meaning the data can only be read.
+	 */
+	template <typename Clock, typename Duration>
+	dlock<const T, dmut> peek_until(const std::chrono::time_point<Clock, Duration>& due)
+	{
+		this->lock_state.lock_shared(Lock::DEFAULT_PRIORITY, dmut_detail::to_deadline(due));
+		return dlock<const T, dmut>(this);
+	}
+
+	/**
+	 * \brief	requests a writers lock on the data from a coroutine, to be awaited.
+	 *			if someone else is holding some lock on the data the coroutine is suspended
+	 *			instead of blocking its thread, and it is queued along with the other
+	 *			suspended coroutines, once a lock is released the lock is acquired on behalf
+	 *			of the queued coroutines, in the order they suspended, and they are resumed
+	 *			through the executor.
+	 *			note: a coroutine queued for the lock does not hold back threads acquiring
+	 *			it with lock(), and while coroutines are queued every release of the lock
+	 *			checks the queue.
+	 * \param	executor called with the coroutine_handle of a coroutine that was granted the lock,
+	 *			by default the coroutine is resumed right away by the thread releasing the lock.
+	 * \return	an awaitable resulting in the lock on the data, the same lock lock() returns.
 	 */
-	
-	template <typename V>
-	struct base_mut_data
+	template <typename Executor = dmut_detail::inline_executor>
+	async_acquire<WRITER_LOCK, Executor> lock_async(Executor executor = Executor())
 	{
-		V *ptr_data;
-		std::atomic_int reader_count;
+		static_assert(ASYNC, "the async acquires are not available with a reentrant lock");
+		return async_acquire<WRITER_LOCK, Executor>(*this, std::move(executor));
+	}
 
-		explicit base_mut_data(V *ptr) : ptr_data(ptr), reader_count(0) {}
-		base_mut_data() : ptr_data(nullptr), reader_count(0) {}
-		base_mut_data(const base_mut_data& other) = delete;
-		base_mut_data(base_mut_data&& other) = delete;
-		virtual ~base_mut_data() = default;
+	/**
+	 * \brief	requests a readers lock on the data from a coroutine, to be awaited,
+	 *			see lock_async.
+	 * \param	executor called with the coroutine_handle of a coroutine that was granted the lock,
+	 *			by default the coroutine is resumed right away by the thread releasing the lock.
+	 * \return	an awaitable resulting in the lock on the data as const, the same lock peek() returns.
+	 */
+	template <typename Executor = dmut_detail::inline_executor>
+	async_acquire<READER_LOCK, Executor> peek_async(Executor executor = Executor())
+	{
+		static_assert(ASYNC, "the async acquires are not available with a reentrant lock");
+		return async_acquire<READER_LOCK, Executor>(*this, std::move(executor));
+	}
 
-		base_mut_data& operator=(const base_mut_data& other) = delete;
-		base_mut_data& operator=(base_mut_data&& other) = delete;
+	/**
+	 * \brief	calls fn with the data while holding a writers lock on it.
+	 *			the lock never leaves the method and no dlock is created,
+	 *			so the whole critical section is visible to the optimizer.
+	 *			if someone else is holding some lock on the data
+	 *			this method will wait until the lock is available.
+	 * \param	fn the function to call with the data.
+	 * \return	the result of calling fn.
+	 */
+	template <typename F>
+	decltype(auto) with_lock(F&& fn)
+	{
+		this->lock_state.lock();
+		begin_write();
 
-		virtual void clean() noexcept { delete this->ptr_data; }
-	};
+		const scoped_release<WRITER_LOCK> release{ *this };
+		return std::forward<F>(fn)(*this->data.get());
+	}
 
-	template <typename V>
-	struct mut_val_data final : base_mut_data<V>
+	/**
+	 * \brief	calls fn with the data while holding a readers lock on it,
+	 *			see with_lock.
+	 *			if someone else is holding a writers lock on the data
+	 *			this method will wait until the lock is released.
+	 * \param	fn the function to call with the data, the data is const.
+	 * \return	the result of calling fn.
+	 */
+	template <typename F>
+	decltype(auto) with_peek(F&& fn)
 	{
-		V data;
+		this->lock_state.lock_shared();
 
-		explicit mut_val_data(V&& data) : base_mut_data<V>(&this->data), data(data) {}
-		mut_val_data(const mut_val_data& other) = delete;
-		mut_val_data(mut_val_data&& other) = delete;
-		virtual ~mut_val_data() = default;
+		const scoped_release<READER_LOCK> release{ *this };
+		return std::forward<F>(fn)(std::as_const(*this->data.get()));
+	}
 
-		mut_val_data& operator=(const mut_val_data& other) = delete;
-		mut_val_data& operator=(mut_val_data&& other) = delete;
-		
-		void clean() noexcept override {}
-	};
+	/**
+	 * \brief	calls fn with every element of the data in parallel while holding a single
+	 *			writers lock on it, the elements are split into chunks run by the threads of
+	 *			a thread_pool and the lock is released once every chunk is done, so the lock
+	 *			is held for a fraction of the time a loop on a single thread would take.
+	 *			if someone else is holding some lock on the data
+	 *			this method will wait until the lock is available.
+	 *			note: this requires data that is a random access range, such as std::vector.
+	 * \param	fn the function to call with every element, or with the begin and end
+	 *			iterators of every chunk when it accepts them, it is called concurrently
+	 *			with distinct elements.
+	 * \param	pool the threads to run the chunks on.
+	 * \throws	the first exception thrown by fn, the chunks not started yet are skipped.
+	 */
+	template <typename F>
+	void parallel_write(F&& fn, thread_pool& pool)
+	{
+		this->lock_state.lock();
+		begin_write();
 
-	base_mut_data<T> *data;
-	
-	// write mutex, ensures that when write access is needed only one thread
-	// can hold a write lock and no read lock can be held.
-    std::mutex mut_w;
-	
-	// read mutex, ensures that two read locks are not acquired concurrently
-	// in order to keep the reader_count thread safe.
-    std::mutex mut_r;
+		const scoped_release<WRITER_LOCK> release{ *this };
+		dmut_detail::parallel_apply(*this->data.get(), fn, pool);
+	}
 
-	friend dlock<const T>;
-	friend dlock<T>;
+	/**
+	 * \brief	calls fn with every element of the data in parallel while holding a single
+	 *			readers lock on it, see parallel_write.
+	 *			if someone else is holding a writers lock on the data
+	 *			this method will wait until the lock is released.
+	 * \param	fn the function to call with every element (or chunk), the elements are const.
+	 * \param	pool the threads to run the chunks on.
+	 * \throws	the first exception thrown by fn, the chunks not started yet are skipped.
+	 */
+	template <typename F>
+	void parallel_read(F&& fn, thread_pool& pool)
+	{
+		this->lock_state.lock_shared();
 
-	
-    /**
-	 * \brief	callback for releasing locks on this dmut.
-	 *			should be called whenever a lock expires.
-	 * \param	type the type of the expiring lock.
+		const scoped_release<READER_LOCK> release{ *this };
+		dmut_detail::parallel_apply(std::as_const(*this->data.get()), fn, pool);
+	}
+
+	/**
+	 * \brief	runs fn on the data under the writers lock, by delegating it to whichever
+	 *			thread holds the lock (flat combining).
+	 *			the operation is published to the dmut and the thread holding the
+	 *			writers lock runs all the published operations in a batch before it
+	 *			releases the lock, so under contention the data stays in the cache of
+	 *			a single core and the lock is not handed over for every operation.
+	 *			if no one runs the operation shortly, the calling thread acquires the
+	 *			lock itself and runs the batch.
+	 *			note: fn may be run by another thread, so it should not rely on
+	 *			thread local state, and it should return its result by value.
+	 * \param	fn the function to call with the data.
+	 * \return	the result of calling fn, an exception thrown by fn is rethrown.
 	 */
-	void on_release(const LOCK_TYPE type) 
+	template <typename F>
+	auto submit(F&& fn) -> typename std::invoke_result<F&, T&>::type
 	{
-		if (type == WRITER_LOCK) this->mut_w.unlock();
-		
+		dmut_detail::submitted_call<T, typename std::remove_reference<F>::type> op(fn);
+
+		dmut_detail::submitted_op<T> *head = this->submitted.load(std::memory_order_relaxed);
+		do op.next = head;
+		while (!this->submitted.compare_exchange_weak(head, &op, std::memory_order_release, std::memory_order_relaxed));
 
-		if (type == READER_LOCK)
+		dmut_detail::backoff backoff;
+		for (unsigned round = 0; round < SUBMIT_ROUNDS && !op.done.load(std::memory_order_acquire); ++round)
 		{
-			//will unlock at the end of the if statement.
-			std::lock_guard<std::mutex> guard(this->mut_r);
-			
-			--data->reader_count;
-			if (data->reader_count == 0) this->mut_w.unlock();
+			if (this->lock_state.try_lock())
+			{
+				// the operation was published before the lock was acquired, so the batch includes it.
+				begin_write();
+				on_release<WRITER_LOCK>();
+				break;
+			}
+
+			on_failed_acquire();
+			backoff.pause();
 		}
+
+		if (!op.done.load(std::memory_order_acquire))
+		{
+			this->lock_state.lock();
+			begin_write();
+			on_release<WRITER_LOCK>();
+		}
+
+		if (op.error) std::rethrow_exception(op.error);
+		if constexpr (!std::is_void<typename std::invoke_result<F&, T&>::type>::value) return std::move(*op.result);
 	}
 
-public:
+	/**
+	 * \brief	queues a write on the data and returns without waiting for it.
+	 *			the queued writes are run in batches, in the order they were queued,
+	 *			whenever a writer releases its lock (including the writers of with_lock,
+	 *			submit and flush_writes), or by the background drainer if it is running
+	 *			(see start_write_drainer), so queuing never waits for readers.
+	 *			writes still queued when the dmut is destroyed are run by the destructor.
+	 *			note: fn is run by another thread and should not throw, an exception
+	 *			thrown by a queued write terminates the program.
+	 * \param	fn the function to call with the data, it is copied or moved into the queue.
+	 */
+	template <typename F>
+	void enqueue_write(F&& fn) { push_write(std::forward<F>(fn), 0, false); }
 
-	explicit dmut(T&& value) : data(new mut_val_data<T>(std::move(value))) {}
-    explicit dmut(T& value) : data(new mut_val_data<T>(std::move(value))) {}
-	explicit dmut(T *value_ptr) : data(new base_mut_data<T>(value_ptr)) {}
-    dmut() = default;
-    dmut(const dmut& other) = delete;
+	/**
+	 * \brief	queues a write on the data which supersedes the writes of the same key,
+	 *			when a batch of queued writes is run only the latest write of every key
+	 *			is run (in its place in the queue), the rest are dropped, see enqueue_write.
+	 * \param	key the key of the write.
+	 * \param	fn the function to call with the data, it is copied or moved into the queue.
+	 */
+	template <typename F>
+	void enqueue_write(const std::size_t key, F&& fn) { push_write(std::forward<F>(fn), key, true); }
 
 	/**
-	 * \brief	constructs a dmut by moving some dmut into a new one.
-	 *			note: this constructor requires a writers lock on the
-	 *			dmut being moved.
-	 * \param	other the dmut being moved.
+	 * \brief	runs the queued writes, waiting for the writers lock.
 	 */
-    dmut(dmut&& other) noexcept
-    {
-		//both mutexes will unlock when the methods returns.
-		std::lock_guard<std::mutex> this_guard(this->mut_w);
-		std::lock_guard<std::mutex> other_guard(other.mut_w);
+	void flush_writes()
+	{
+		this->lock_state.lock();
+		begin_write();
+		on_release<WRITER_LOCK>();
+	}
 
-		this->data = other.data;
-		other.data = nullptr;
-    }
+	/**
+	 * \brief	starts a background thread running the queued writes as soon as they are queued,
+	 *			the thread runs until stop_write_drainer is called or the dmut is destroyed.
+	 *			note: a drainer should not be started and stopped concurrently.
+	 */
+	void start_write_drainer()
+	{
+		dmut_detail::write_queue<T>& pending = write_queue();
+		if (pending.draining.exchange(true)) return;
 
-    ~dmut() 
-    {
-    	// this will ensure that the mutex cannot be destroyed while
-    	// someone holds a lock on its data.
-		std::lock_guard<std::mutex> guard(this->mut_w);
-		data->clean();
-		delete data;
-    }
+		pending.drainer = std::thread([this, &pending] { drain_writes(pending); });
+	}
 
-	dmut& operator=(const dmut& other) = delete;
+	/**
+	 * \brief	stops the background thread running the queued writes, if it is running,
+	 *			the writes still queued are run by the next writer.
+	 */
+	void stop_write_drainer() noexcept
+	{
+		dmut_detail::write_queue<T> *pending = this->queue.load(std::memory_order_acquire);
+		if (pending == nullptr || !pending->draining.exchange(false)) return;
 
-    /**
-	 * \brief	moves some dmut into this one.
-	 *			note: this operation requires a writers lock on both dmuts,
-	 *			thus the method may block for a long time if both dmuts are active.
-	 * \param	other the dmut being moved into this one.
-	 * \return	a reference to this dmut.
+		pending->signal.store(1);
+		dmut_detail::wake_one(pending->signal);
+		pending->drainer.join();
+	}
+
+	/**
+	 * \brief	wakes every thread waiting for the data to satisfy a predicate (see dlock::wait)
+	 *			so they evaluate their predicates again, meant for predicates that depend on
+	 *			something other than the data, writers releasing the lock wake the waiters
+	 *			whose predicates are satisfied on their own.
 	 */
-	dmut& operator=(dmut&& other) noexcept
+	void notify_all() noexcept
 	{
-		//both mutexes will unlock when the methods returns.
-		std::lock_guard<std::mutex> this_guard(this->mut_w);
-		std::lock_guard<std::mutex> other_guard(other.mut_w);
-		
-		this->data = other.data;
-		other.data = nullptr;
-		
-		return *this;
+		dmut_detail::condition_queue *waiters = this->conditions.load(std::memory_order_acquire);
+		if (waiters == nullptr) return;
+
+		std::lock_guard<std::mutex> guard(waiters->guard);
+		while (waiters->head != nullptr) waiters->wake(*waiters->head);
 	}
 
-	
-    /**
-     * \brief	requests a writers lock on the data.
-     *			if someone else is already holding some lock on this data
-     *			this method will wait until the lock is available.
-     *			for non blocking requests see 'try_lock'.
-     * \return the lock on the data with ability to read and write to the underlying memory.
-     * 
-     */
-    dlock<T> lock()
-    {
-		this->mut_w.lock();
-		return dlock<T>(data->ptr_data, this, WRITER_LOCK);
+	/**
+	 * \brief	reads the data without acquiring any lock (seqlock style).
+	 *			the data is copied and the copy is only used if no writer
+	 *			has touched the data while it was being copied, otherwise
+	 *			the read is retried, this way readers do not write to any
+	 *			shared memory and do not slow each other down.
+	 *			if the data keeps changing the method falls back to
+	 *			acquiring a readers lock.
+	 *			note: fn is called with a copy of the data, not the data itself,
+	 *			so it should return its result by value.
+	 *			note: with pointer_storage the data is always read under a readers lock,
+	 *			since data replaced by publish may be deleted while it is copied.
+	 * \param	fn the function to call with the data.
+	 * \return	the result of calling fn.
+	 */
+	template <typename F>
+	auto read_optimistic(F&& fn) -> decltype(fn(std::declval<const T&>()))
+	{
+		static_assert(std::is_trivially_copyable<T>::value,
+			"read_optimistic requires a trivially copyable type, for which observing a torn copy is harmless");
+		static_assert(VERSIONED || SINGLE_THREADED, "read_optimistic is not available when writers elide the lock or the lock is reentrant");
+
+		// no writer can be writing while a single thread reads.
+		if constexpr (SINGLE_THREADED) return fn(std::as_const(*this->data.get()));
+
+		// data replaced by publish may be deleted while it is being copied,
+		// so without a lock the copy is only safe for data stored by the dmut.
+		constexpr unsigned ATTEMPTS = storage::OWNS_POINTER ? 0 : OPTIMISTIC_ATTEMPTS;
+
+		for (unsigned attempt = 0; attempt < ATTEMPTS; ++attempt)
+		{
+			const std::uint32_t before = this->version.load(std::memory_order_acquire);
+			if (before & 1) continue;
+
+			alignas(T) unsigned char copy[sizeof(T)];
+			std::memcpy(copy, this->data.get(), sizeof(T));
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (this->version.load(std::memory_order_relaxed) == before)
+				return fn(*std::launder(reinterpret_cast<const T*>(copy)));
+		}
+
+		const dlock<const T, dmut> lock = peek();
+		return fn(*lock);
 	}
-	
-    /**
-	 * \brief	requests a writers lock on the data.
-	 *			if someone else is already holding some lock on this data
-	 *			the lock will not be acquired and the method will return.
-	 * \return a pair of bool and dlock, the bool represents whether or not
-	 *			the lock was acquired and the dlock is the lock itself.
-	 *			in case the lock is not acquired a dlock pointing to null will be returned.
+
+	/**
+	 * \brief	replaces the data with a new value without waiting for readers.
+	 *			the method waits for a writer (or upgradeable reader) holding the lock,
+	 *			but it never waits for readers, readers locking the data from now on
+	 *			refer to the new value, while a reader holding a readers lock keeps
+	 *			a valid reference to the value it found, the replaced value is deleted
+	 *			once no lock can refer to it anymore, that is once the writers lock is
+	 *			acquired, right away if there are no readers or by the next writer.
+	 *			note: a readers lock keeps referring to the value it found when it was
+	 *			acquired, readers see the new value by locking the data again.
+	 *			note: this requires pointer_storage and a Lock supporting upgrades,
+	 *			such as lock_word.
+	 * \param	value the new value of the data, must not be null.
 	 */
-	std::pair<bool, dlock<T>> try_lock()
+	void publish(std::unique_ptr<T> value) requires (storage::OWNS_POINTER)
 	{
-		if (this->mut_w.try_lock())
-			return std::make_pair(true, dlock<T>(data->ptr_data, this, WRITER_LOCK));
+		this->lock_state.lock_upgrade();
+		{
+			const scoped_release<UPGRADE_LOCK> release{ *this };
+			this->data.replace(value);
+		}
 
-		return std::make_pair(false, dlock<T>()); 
+		// without readers the replaced value can be deleted right away.
+		if (this->lock_state.try_lock())
+		{
+			begin_write();
+			on_release<WRITER_LOCK>();
+		}
+		else on_failed_acquire();
 	}
 
+	/**
+	 * \brief	replaces the data with a new value and hands the previous value back,
+	 *			the value is replaced without waiting for readers (see publish), but the
+	 *			method returns only once the readers which might refer to the previous
+	 *			value have released their locks.
+	 *			note: this requires pointer_storage and a Lock supporting upgrades,
+	 *			such as lock_word.
+	 * \param	value the new value of the data, must not be null.
+	 * \return	the previous value of the data.
+	 */
+	std::unique_ptr<T> exchange(std::unique_ptr<T> value) requires (storage::OWNS_POINTER)
+	{
+		this->lock_state.lock_upgrade();
+		std::unique_ptr<T> previous = this->data.exchange(value);
+
+		// no writer can get in between, and once the readers leave nothing refers to the previous value.
+		this->lock_state.unlock_upgrade_and_lock();
+		begin_write();
+		on_release<WRITER_LOCK>();
 
-    /**
-	 * \brief	requests a readers lock on the data.
-	 *			if someone else is holding a writers lock on the data
+		return previous;
+	}
+
+	/**
+	 * \brief	sets the maximum number of pause instructions a contended acquire
+	 *			may spin for before parking, see lock_word.
+	 *			note: this requires a Lock supporting spinning, such as lock_word.
+	 * \param	budget the number of pause instructions, 0 disables spinning.
+	 */
+	void set_spin_budget(const std::uint32_t budget) noexcept { this->lock_state.set_spin_budget(budget); }
+
+	/**
+	 * \brief	the lock elision counters of the dmut, see elision_lock.
+	 *			note: this requires a Lock supporting elision, such as elision_lock.
+	 */
+	auto elision_stats() const noexcept { return this->lock_state.stats(); }
+
+	/**
+	 * \brief	the contention profile of the dmut, see profiled_lock.
+	 *			note: this requires a Lock supporting profiling, such as profiled_lock.
+	 */
+	lock_profile profile() const noexcept { return this->lock_state.profile(); }
+
+	/**
+	 * \brief	registers the dmut in the global registry under a name, see dmut_registry.
+	 *			note: this requires a Lock supporting profiling, such as profiled_lock.
+	 * \param	name the name to register under, registering again renames the dmut.
+	 */
+	void profile_as(std::string name) { this->lock_state.register_as(std::move(name)); }
+
+	/**
+	 * \brief	requests an upgradeable readers lock on the data.
+	 *			the lock behaves as a readers lock and coexists with other readers,
+	 *			but only one upgradeable lock can be held at a time and it can later
+	 *			be turned into a writers lock without releasing it (see upgrade).
+	 *			if someone else is holding a writers lock or an upgradeable lock
 	 *			this method will wait until the lock is released.
-	 *			for non blocking requests see 'try_peek'.
+	 *			for non blocking requests see 'try_peek_upgradeable'.
+	 *			note: this requires a Lock supporting upgrades, such as lock_word.
 	 * \return the lock on the data as const, meaning the data can only be read.
 	 */
-	dlock<const T> peek()
+	upgrade_lock peek_upgradeable()
 	{
-		//will unlock the readers mutex whenever the method returns.
-		std::lock_guard<std::mutex> guard(this->mut_r);
-		
-		++data->reader_count;
-		if (data->reader_count == 1) this->mut_w.lock();
-		return dlock<const T>(data->ptr_data, this, READER_LOCK);
+		this->lock_state.lock_upgrade();
+		return upgrade_lock(this);
 	}
 
-    /**
-	 * \brief	requests a readers lock on the data.
-	 *			if someone else is holding a writers lock on the data
-	 *			the lock will not be acquired and the method will return.
-	 *			note: if someone else is attempting to acquire a readers lock
-	 *			at the same time, the method might block for a small amount of time
-	 *			while other threads are acquiring the lock.
+	/**
+	 * \brief	requests an upgradeable readers lock on the data.
+	 *			if someone else is holding a writers lock or an upgradeable lock
+	 *			on the data the lock will not be acquired and the method will return.
 	 * \return a pair of bool and dlock, the bool represents whether or not the lock
 	 *			was acquired and the dlock is the lock itself.
 	 *			in case the lock cannot be acquired a dlock pointing to null will re returned.
 	 */
-	std::pair<bool, dlock<T>> try_peek()
+	std::pair<bool, upgrade_lock> try_peek_upgradeable()
 	{
-		//will unlock the readers mutex whenever the method returns.
-		std::lock_guard<std::mutex> guard(this->mut_r);
-		
-		++data->reader_count;
-		if (data->reader_count == 1)
-		{
-			if (this->mut_w.try_lock())
-				return std::make_pair(true, dlock<const T>(data->ptr_data, this, READER_LOCK));
-			
+		if (this->lock_state.try_lock_upgrade())
+			return std::make_pair(true, upgrade_lock(this));
 
-			--data->reader_count;
-			return std::make_pair(false, dlock<const T>());
-		}
-		
-		return std::make_pair(true, dlock<const T>(data->ptr_data, this, READER_LOCK));
+		on_failed_acquire();
+		return std::make_pair(false, upgrade_lock());
+	}
+
+	/**
+	 * \brief	turns an upgradeable readers lock into a writers lock without releasing it,
+	 *			no writer can modify the data in between, so whatever was read through
+	 *			the upgradeable lock is still valid once the writers lock is acquired.
+	 *			the method waits for the plain readers currently holding the lock to leave.
+	 * \param	lock an upgradeable readers lock acquired from this dmut.
+	 * \return the writers lock on the data, in case the given lock is not an upgradeable
+	 *			lock of this dmut, it is left untouched and a dlock pointing to null is returned.
+	 */
+	dlock<T, dmut> upgrade(upgrade_lock&& lock)
+	{
+		if (lock.owner != this) return dlock<T, dmut>();
+
+		lock.detach();
+		this->lock_state.unlock_upgrade_and_lock();
+		begin_write();
+		return dlock<T, dmut>(this);
+	}
+
+	/**
+	 * \brief	turns a writers lock into a readers lock without releasing it,
+	 *			no other writer can acquire the lock in between.
+	 *			the queued writes are run and the waiters are notified first,
+	 *			as if the writers lock was released.
+	 * \param	lock a writers lock acquired from this dmut.
+	 * \return the readers lock on the data, in case the given lock is not a writers
+	 *			lock of this dmut, it is left untouched and a dlock pointing to null is returned.
+	 */
+	dlock<const T, dmut> downgrade(dlock<T, dmut>&& lock)
+	{
+		if (lock.owner != this) return dlock<const T, dmut>();
+
+		// the writer releases its write access just as on_release does, only keeping a readers lock.
+		lock.detach();
+		run_submitted();
+		run_queued();
+		if constexpr (storage::OWNS_POINTER) this->data.reclaim();
+
+		notify_conditions();
+		end_write();
+		this->lock_state.unlock_and_lock_shared();
+
+		// coroutines waiting to read can now share the lock.
+		resume_async();
+		return dlock<const T, dmut>(this);
 	}
 };
 
 /**
- * \brief Creates a dmut, allocating the data it guards on the stack.
+ * \brief	a dmut guarded by a big_reader_lock, meant for data that is read
+ *			by many threads at once and only rarely written.
+ *			note: dlock<T> and dlock<const T> name the locks of the default dmut,
+ *			the locks of a brdmut are brdmut<T>::write_lock and brdmut<T>::read_lock
+ *			(see write_lock_t and read_lock_t), as for any other dmut.
+ * \tparam T The type of data that the mutex guards.
+ */
+template <typename T>
+using brdmut = dmut<T, big_reader_lock<>>;
+
+/**
+ * \brief	the type of the writers lock issued by a mutex, such as a dmut, a brdmut or an rcu_dmut,
+ *			for code which is generic over the mutex (or its lock policy).
+ * \tparam M The type of the mutex.
+ */
+template <typename M>
+using write_lock_t = typename M::write_lock;
+
+/**
+ * \brief	the type of the readers lock issued by a mutex, see write_lock_t.
+ * \tparam M The type of the mutex.
+ */
+template <typename M>
+using read_lock_t = typename M::read_lock;
+
+/**
+ * \brief Creates a dmut, storing the data it guards inside the dmut.
  * \tparam T the type of data the mutex should guard.
  * \tparam U the parameter types required to construct the object.
  * \param args the parameters required to construct the object.
@@ -287,7 +4817,7 @@ public:
 template <typename T, typename ...U>
 dmut<T> make_dmut(U&& ...args)
 {
-	return dmut<T>(T(std::forward<U>(args)...));
+	return dmut<T>(std::in_place, std::forward<U>(args)...);
 }
 
 /**
@@ -298,70 +4828,243 @@ dmut<T> make_dmut(U&& ...args)
  * \return a dmut containing the newly constructed object of type T.
  */
 template<typename T, typename ...U>
-dmut<T> new_dmut(U&& ...args)
+dmut<T, reader_preferring_lock, pointer_storage> new_dmut(U&& ...args)
+{
+	return dmut<T, reader_preferring_lock, pointer_storage>(std::in_place, std::forward<U>(args)...);
+}
+
+/**
+ * \brief Creates a dmut, allocating the data it guards through an allocator.
+ * \tparam T the type of data the mutex should guard.
+ * \tparam Allocator the type of the allocator.
+ * \tparam U the parameter types required to construct the object.
+ * \param allocator the allocator used to allocate the data,
+ *			and handed to the data if it uses an allocator.
+ * \param args the parameters required to construct the object.
+ * \return a dmut containing the newly constructed object of type T.
+ */
+template <typename T, typename Allocator, typename ...U>
+dmut<T, reader_preferring_lock, allocated_storage<Allocator>> allocate_dmut(const Allocator& allocator, U&& ...args)
+{
+	return dmut<T, reader_preferring_lock, allocated_storage<Allocator>>(std::allocator_arg, allocator, std::forward<U>(args)...);
+}
+
+struct dmut_detail::access
 {
-	return dmut<T>(new T(std::forward<U>(args)...));
+	template <typename T, typename Lock, typename Storage>
+	static lockable<dmut<T, Lock, Storage>, false> lockable_of(dmut<T, Lock, Storage>& mutex) noexcept
+	{
+		return lockable<dmut<T, Lock, Storage>, false>(mutex);
+	}
+	
+	template <typename T, typename Lock, typename Storage>
+	static lockable<dmut<T, Lock, Storage>, true> lockable_of(const dmut<T, Lock, Storage>& mutex) noexcept
+	{
+		return lockable<dmut<T, Lock, Storage>, true>(const_cast<dmut<T, Lock, Storage>&>(mutex));
+	}
+
+	template <typename T, typename Lock, typename Storage>
+	static write_lock_t<dmut<T, Lock, Storage>> adopt(dmut<T, Lock, Storage>& mutex) noexcept { return mutex.adopt_lock(); }
+
+	template <typename T, typename Lock, typename Storage>
+	static read_lock_t<dmut<T, Lock, Storage>> adopt(const dmut<T, Lock, Storage>& mutex) noexcept
+	{
+		return const_cast<dmut<T, Lock, Storage>&>(mutex).adopt_peek();
+	}
+};
+
+/**
+ * \brief	acquires locks on several dmuts at once without risking a deadlock,
+ *			no matter the order in which other threads acquire the same dmuts.
+ *			a dmut passed as non const is locked for writing, while a dmut passed
+ *			as const (for example through std::as_const) is locked for reading,
+ *			so read and write modes can be mixed in a single call.
+ *			if some lock is busy every lock acquired so far is released and the
+ *			busy lock is waited for first, so the call never holds a lock while
+ *			waiting for another one (see std::lock).
+ *			note: a dmut may not be passed more than once.
+ * \param	mutexes the dmuts to lock.
+ * \return	a tuple holding the locks in the order the dmuts were given,
+ *			the write_lock of every dmut locked for writing and the read_lock
+ *			of every dmut locked for reading (see write_lock_t and read_lock_t).
+ */
+template <typename ...M>
+auto dmut_lock_all(M& ...mutexes)
+{
+	static_assert(sizeof...(M) > 0, "dmut_lock_all requires at least one dmut");
+
+	auto lockables = std::make_tuple(dmut_detail::access::lockable_of(mutexes)...);
+	std::apply([](auto& ...locks) { dmut_detail::lock_all(locks...); }, lockables);
+
+	return std::make_tuple(dmut_detail::access::adopt(mutexes)...);
+}
+
+/**
+ * \brief	acquires readers locks on several dmuts at once, see dmut_lock_all.
+ * \param	mutexes the dmuts to peek.
+ * \return	a tuple holding the read_lock of every dmut,
+ *			in the order the dmuts were given.
+ */
+template <typename ...M>
+auto dmut_peek_all(M& ...mutexes)
+{
+	return dmut_lock_all(std::as_const(mutexes)...);
 }
 
 /**
  * \brief	a lock for data of type T.
- *			this lock operates very similarly to a unique_ptr
- *			which is why it inherits it, when the lock is acquired
- *			it is capable of accessing the data just as a unique_ptr
- *			would, the only difference being when the lock is destroyed
- *			it notifies the mutex and the lock is released.
- *			in addition the methods release and reset cannot be called.
+ *			the lock is a handle to the mutex that issued it, when the lock is
+ *			acquired it is capable of accessing the data just as a pointer would,
+ *			and when the lock is destroyed it notifies the mutex and the lock is released.
+ *			the type of the lock is part of the type of the dlock, so the handle
+ *			holds nothing but a pointer to the mutex and releasing it does not
+ *			need to look at the kind of lock it is.
+ *			a readers lock of a mutex whose data may be replaced while readers hold
+ *			the lock (PINS_READERS, see dmut::publish) also holds the data it found
+ *			when it was acquired, so it keeps referring to the same data until released.
+ *
+ *			the mutex (the owner) must provide:
+ *
+ *			*	locked_data() - the data the lock refers to.
+ *
+ *			*	on_release<TYPE>() - called once the lock expires.
  *			
  * \tparam T The type of data the lock refers to.
+ * \tparam M The type of the mutex that issued the lock, when making a readers lock
+ *			the type of the dlock should be const T, but the type of the owner
+ *			remains a mutex of T.
+ * \tparam TYPE The type of the lock, a writers lock for T and a readers
+ *			lock for const T by default.
  */
-template <typename T>
-class dlock : std::unique_ptr<T>
+template <typename T, typename M, LOCK_TYPE TYPE>
+class dlock
 {
-	// when making a readers lock the type of the dlock should
-	// be const T, but the type of the owner remains T,
-	// remove_const to make mut_type always T.
-	typedef typename std::remove_const<T>::type mut_type;
-	
-	LOCK_TYPE type;
-	dmut<mut_type> *owner;
+	static_assert((TYPE == WRITER_LOCK) != std::is_const<T>::value, "only a writers lock may refer to mutable data");
+
+	struct unpinned {};
+
+	static constexpr bool PINNED = TYPE == READER_LOCK && requires { requires M::PINS_READERS; };
+
+	M *owner;
+
+	// the data found when the lock was acquired, only held when PINNED.
+	[[no_unique_address]] typename std::conditional<PINNED, T*, unpinned>::type pinned;
+
+	friend M;
+
+	static auto pin(M *owner) noexcept
+	{
+		if constexpr (PINNED) return owner != nullptr ? static_cast<T*>(owner->locked_data()) : nullptr;
+		else return unpinned{};
+	}
+
+	T* data() const noexcept
+	{
+		if constexpr (PINNED) return this->pinned;
+		else return this->owner->locked_data();
+	}
+
+	/**
+	 * \brief	detaches the lock from the owner without releasing it,
+	 *			the owner becomes responsible for the lock.
+	 */
+	void detach() noexcept { this->owner = nullptr; }
 
 public:
-	dlock(T *ptr, dmut<mut_type> *owner, const LOCK_TYPE type) : std::unique_ptr<T>(ptr), type(type), owner(owner) {}
-	dlock(dlock&& other) noexcept : std::unique_ptr<T>(std::move(other)), type(other.type), owner(other.owner) {}
+	dlock() noexcept : owner(nullptr), pinned() {}
+	explicit dlock(M *owner) noexcept : owner(owner), pinned(pin(owner)) {}
+	dlock(dlock&& other) noexcept : owner(std::exchange(other.owner, nullptr)), pinned(other.pinned) {}
 	dlock(const dlock& other) = delete;
 
 	dlock& operator=(const dlock& other) = delete;
 	dlock& operator=(dlock&& other) noexcept
 	{
-		std::unique_ptr<T>::operator=(std::move(other));
-		this->owner = other.owner;
-		other.owner = nullptr;
-		this->type = type;
-		other.type = NO_LOCK;
+		if (this == &other) return *this;
+
+		// the lock currently held by this object is released before taking over.
+		unlock();
+		this->owner = std::exchange(other.owner, nullptr);
+		this->pinned = other.pinned;
 
 		return *this;
 	}
 
 	~dlock() { unlock(); }
 	
-	T& operator*() const { return std::unique_ptr<T>::operator*(); }
-	T* operator->() const noexcept { return std::unique_ptr<T>::operator->(); }
+	T& operator*() const noexcept { return *data(); }
+	T* operator->() const noexcept { return data(); }
 
 	/**
 	 * \brief	releases the lock to the data rendering this object useless,
-	 *			has a similar effect to std::unique_ptr::reset() or setting a
-	 *			pointer to nullptr.
+	 *			has a similar effect to setting a pointer to nullptr.
 	 */
 	void unlock() noexcept
 	{
-		// the unique_ptr is being released without being deleted because
-		// the data is still held by the owner, and it might even be stack allocated
-		// and as such will cause an exception if the unique_ptr destructor
-		// will try to delete it.
-		this->release();  // NOLINT(bugprone-unused-return-value)
-		owner->on_release(type);
+		if (this->owner != nullptr) this->owner->template on_release<TYPE>();
 		this->owner = nullptr;
-		this->type = NO_LOCK;
+	}
+
+	/**
+	 * \brief	turns this upgradeable readers lock into a writers lock
+	 *			without releasing it, see dmut::upgrade.
+	 * \return the writers lock, this object is rendered useless.
+	 */
+	auto upgrade() requires (TYPE == UPGRADE_LOCK) { return this->owner->upgrade(std::move(*this)); }
+
+	/**
+	 * \brief	turns this writers lock into a readers lock
+	 *			without releasing it, see dmut::downgrade.
+	 * \return the readers lock, this object is rendered useless.
+	 */
+	auto downgrade() requires (TYPE == WRITER_LOCK) { return this->owner->downgrade(std::move(*this)); }
+
+	/**
+	 * \brief	waits until the data satisfies a predicate, the lock is released while
+	 *			waiting and held again once the method returns, much like waiting on a
+	 *			std::condition_variable but without a mutex of its own.
+	 *			the predicate is evaluated by every writer releasing the lock, and only
+	 *			the waiters whose predicate is satisfied are woken (the first one of them
+	 *			when waiting with a writers lock), for predicates depending on anything
+	 *			other than the data see dmut::notify_all.
+	 *			note: the predicate is called by other threads while the lock is held
+	 *			by them, so it should only depend on the data it is given.
+	 * \param	pred called with the data as const, returns whether to stop waiting.
+	 */
+	template <typename Pred>
+	void wait(Pred pred) requires (TYPE != UPGRADE_LOCK)
+	{
+		this->owner->template wait_on<TYPE>(pred, nullptr);
+
+		// the lock was released while waiting, the data might have been replaced meanwhile.
+		this->pinned = pin(this->owner);
+	}
+
+	/**
+	 * \brief	waits until the data satisfies a predicate or the timeout expires, see wait.
+	 * \param	pred called with the data as const, returns whether to stop waiting.
+	 * \param	timeout the longest time to wait for.
+	 * \return	whether the predicate is satisfied, the lock is held either way.
+	 */
+	template <typename Pred, typename Rep, typename Period>
+	bool wait_for(Pred pred, const std::chrono::duration<Rep, Period>& timeout) requires (TYPE != UPGRADE_LOCK)
+	{
+		return wait_until(std::move(pred), std::chrono::steady_clock::now() + timeout);
+	}
+
+	/**
+	 * \brief	waits until the data satisfies a predicate or the deadline passes, see wait.
+	 * \param	pred called with the data as const, returns whether to stop waiting.
+	 * \param	until the deadline for the wait.
+	 * \return	whether the predicate is satisfied, the lock is held either way.
+	 */
+	template <typename Pred, typename Clock, typename Duration>
+	bool wait_until(Pred pred, const std::chrono::time_point<Clock, Duration>& until) requires (TYPE != UPGRADE_LOCK)
+	{
+		const dmut_detail::deadline due = dmut_detail::to_deadline(until);
+		const bool satisfied = this->owner->template wait_on<TYPE>(pred, &due);
+		this->pinned = pin(this->owner);
+
+		return satisfied;
 	}
 	
 };
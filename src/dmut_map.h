@@ -0,0 +1,198 @@
+#ifndef DMUT_MAP_H
+#define DMUT_MAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+
+#include "dmut.h"
+
+
+/**
+ * \brief	A hash map split into shards, every shard is an unordered_map guarded
+ *			by a dmut of its own, and every key belongs to exactly one shard.
+ *			writers of keys in different shards never wait for each other,
+ *			so the map scales with the number of shards instead of serializing
+ *			every writer on a single lock.
+ *
+ *			the map is accessed a shard at a time, a lock on the shard owning
+ *			a key gives access to that key along with the rest of the shard,
+ *			as long as the lock is held the key is guaranteed to stay in the shard.
+ *
+ *			notes:
+ *
+ *			*	keys are routed to shards by the upper bits of their scrambled hash,
+ *				the lower bits are left for the buckets of the shard itself,
+ *				so a shard does not end up using only a fraction of its buckets.
+ *
+ *			*	operations on several keys lock several shards, to lock shards
+ *				at once without risking a deadlock see dmut_lock_all.
+ *
+ * \tparam K the type of the keys.
+ * \tparam V the type of the values.
+ * \tparam SHARDS the number of shards, must be a power of two, by default (0)
+ *			the number of shards is the smallest power of two above the number
+ *			of cores, decided when the map is constructed.
+ * \tparam Hash the hash function of the keys.
+ * \tparam KeyEqual the equality of the keys.
+ * \tparam Lock the readers-writer lock guarding every shard, see dmut.
+ */
+template <typename K, typename V, std::size_t SHARDS = 0, typename Hash = std::hash<K>,
+	typename KeyEqual = std::equal_to<K>, typename Lock = reader_preferring_lock>
+class dmut_map
+{
+	static_assert((SHARDS & (SHARDS - 1)) == 0, "the number of shards must be a power of two");
+
+public:
+
+	typedef std::unordered_map<K, V, Hash, KeyEqual> shard_type;
+	typedef dmut<shard_type, Lock> shard_mutex;
+
+	typedef typename shard_mutex::write_lock write_lock;
+	typedef typename shard_mutex::read_lock read_lock;
+
+private:
+
+	std::unique_ptr<shard_mutex[]> shards;
+
+	// log2 of the number of shards.
+	unsigned shard_bits;
+
+	Hash hasher;
+
+	/**
+	 * \brief	the smallest power of two above the number of cores.
+	 */
+	static unsigned default_shard_bits() noexcept
+	{
+		const unsigned cores = std::thread::hardware_concurrency();
+
+		unsigned bits = 1;
+		while (bits < sizeof(std::size_t) * 8 - 1 && (std::size_t(1) << bits) <= cores) ++bits;
+		return bits;
+	}
+
+	static constexpr unsigned shard_bits_of(std::size_t shards) noexcept
+	{
+		unsigned bits = 0;
+		while (shards > 1)
+		{
+			shards >>= 1;
+			++bits;
+		}
+		return bits;
+	}
+
+	/**
+	 * \brief	the index of the shard a key belongs to.
+	 */
+	std::size_t index_of(const K& key) const
+	{
+		if (this->shard_bits == 0) return 0;
+
+		// fibonacci hashing, the multiplication moves the entropy
+		// of the hash into its upper bits.
+		constexpr std::size_t GOLDEN = sizeof(std::size_t) == 8 ? std::size_t(0x9E3779B97F4A7C15ull) : std::size_t(0x9E3779B9u);
+		return (this->hasher(key) * GOLDEN) >> (sizeof(std::size_t) * 8 - this->shard_bits);
+	}
+
+public:
+
+	explicit dmut_map(const Hash& hash = Hash())
+		: shard_bits(SHARDS == 0 ? default_shard_bits() : shard_bits_of(SHARDS)), hasher(hash)
+	{
+		this->shards.reset(new shard_mutex[shard_count()]);
+	}
+
+	dmut_map(const dmut_map& other) = delete;
+	dmut_map(dmut_map&& other) = delete;
+
+	dmut_map& operator=(const dmut_map& other) = delete;
+	dmut_map& operator=(dmut_map&& other) = delete;
+
+	/**
+	 * \brief	the number of shards the map is split into.
+	 */
+	std::size_t shard_count() const noexcept { return std::size_t(1) << this->shard_bits; }
+
+	/**
+	 * \brief	the dmut guarding the shard a key belongs to.
+	 */
+	shard_mutex& shard_of(const K& key) { return this->shards[index_of(key)]; }
+
+	/**
+	 * \brief	requests a writers lock on the shard a key belongs to.
+	 *			if someone else is holding some lock on the shard
+	 *			this method will wait until the lock is available.
+	 * \param	key the key.
+	 * \return	the lock on the shard with ability to read and write to it.
+	 */
+	write_lock lock(const K& key) { return shard_of(key).lock(); }
+
+	/**
+	 * \brief	requests a readers lock on the shard a key belongs to.
+	 *			if someone else is holding a writers lock on the shard
+	 *			this method will wait until the lock is released.
+	 * \param	key the key.
+	 * \return	the lock on the shard as const, meaning the shard can only be read.
+	 */
+	read_lock peek(const K& key) { return shard_of(key).peek(); }
+
+	/**
+	 * \brief	calls fn with the shard a key belongs to while holding
+	 *			a writers lock on the shard.
+	 * \param	key the key.
+	 * \param	fn the function to call with the shard.
+	 * \return	the result of calling fn.
+	 */
+	template <typename F>
+	decltype(auto) with_write(const K& key, F&& fn)
+	{
+		return shard_of(key).with_lock(std::forward<F>(fn));
+	}
+
+	/**
+	 * \brief	calls fn with the shard a key belongs to while holding
+	 *			a readers lock on the shard.
+	 * \param	key the key.
+	 * \param	fn the function to call with the shard, the shard is const.
+	 * \return	the result of calling fn.
+	 */
+	template <typename F>
+	decltype(auto) with_read(const K& key, F&& fn)
+	{
+		return shard_of(key).with_peek(std::forward<F>(fn));
+	}
+
+	/**
+	 * \brief	calls fn with every shard in turn while holding a readers lock
+	 *			on that shard only, the shards are not locked at once, so the scan
+	 *			does not see a single point in time of the whole map.
+	 * \param	fn the function to call with every shard, the shard is const.
+	 */
+	template <typename F>
+	void for_each_shard(F&& fn)
+	{
+		for (std::size_t i = 0; i < shard_count(); ++i)
+			this->shards[i].with_peek(fn);
+	}
+
+	/**
+	 * \brief	calls fn with every shard in turn while holding a writers lock
+	 *			on that shard only, see for_each_shard.
+	 * \param	fn the function to call with every shard.
+	 */
+	template <typename F>
+	void for_each_shard_write(F&& fn)
+	{
+		for (std::size_t i = 0; i < shard_count(); ++i)
+			this->shards[i].with_lock(fn);
+	}
+};
+
+
+#endif
@@ -0,0 +1,432 @@
+#ifndef RANGE_DMUT_H
+#define RANGE_DMUT_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "dmut.h"
+
+
+/**
+ * \brief	Range policy of a range_dmut, the elements are split into a fixed number
+ *			of stripes, each guarded by a readers-writer lock on a cache line of its own,
+ *			a range locks the stripes it covers, in order.
+ *			locking is cheap and never allocates, but ranges sharing a stripe
+ *			exclude each other even if they do not overlap.
+ * \tparam STRIPES the number of stripes.
+ * \tparam Lock the lock of every stripe.
+ */
+template <std::size_t STRIPES = 64, typename Lock = reader_preferring_lock>
+class striped_ranges
+{
+	static_assert(STRIPES > 0, "striped_ranges requires at least one stripe");
+
+	struct alignas(dmut_detail::CACHE_LINE) stripe
+	{
+		Lock lock_state;
+	};
+
+	stripe stripes[STRIPES];
+
+	static std::size_t stripe_of(const std::size_t index, const std::size_t size) noexcept
+	{
+		// the stripes split the elements evenly, without overflowing for large containers.
+		return static_cast<std::size_t>(static_cast<unsigned long long>(index) * STRIPES / size);
+	}
+
+public:
+
+	/**
+	 * \brief	the stripes held by a range lock.
+	 */
+	struct ticket
+	{
+		std::size_t first;
+		std::size_t last;
+		bool shared;
+	};
+
+	ticket lock(const std::size_t begin, const std::size_t end, const std::size_t size, const bool shared)
+	{
+		if (begin == end) return ticket{ 0, 0, shared };
+
+		const ticket held{ stripe_of(begin, size), stripe_of(end - 1, size) + 1, shared };
+		for (std::size_t i = held.first; i < held.last; ++i)
+		{
+			if (shared) this->stripes[i].lock_state.lock_shared();
+			else this->stripes[i].lock_state.lock();
+		}
+
+		return held;
+	}
+
+	void unlock(const ticket& held) noexcept
+	{
+		for (std::size_t i = held.first; i < held.last; ++i)
+		{
+			if (held.shared) this->stripes[i].lock_state.unlock_shared();
+			else this->stripes[i].lock_state.unlock();
+		}
+	}
+};
+
+/**
+ * \brief	Range policy of a range_dmut, the ranges currently held are kept sorted
+ *			by their first element, a range waits only for the held ranges it
+ *			actually overlaps (readers overlap readers freely).
+ *			every lock and unlock takes a short internal lock and updates the set
+ *			of held ranges, which pays off for large containers accessed by ranges
+ *			of arbitrary sizes.
+ *			note: waiting ranges are not queued, a range overlapping a steady stream
+ *			of other ranges may wait for long.
+ */
+class interval_ranges
+{
+	struct held_range
+	{
+		std::size_t end;
+		bool shared;
+	};
+
+	typedef std::multimap<std::size_t, held_range> range_set;
+
+	dmut_detail::spinlock guard;
+	range_set held;
+
+	// bumped whenever a range is released, ranges waiting for others park on it.
+	std::atomic<std::uint32_t> released{0};
+
+	// the longest range held, bounds the search for ranges overlapping a new one.
+	std::size_t longest = 0;
+
+	bool overlaps(const std::size_t begin, const std::size_t end, const bool shared) const noexcept
+	{
+		// only ranges starting before the end of the new range can overlap it,
+		// and none of them starts earlier than the longest range allows.
+		auto it = this->held.lower_bound(begin > this->longest ? begin - this->longest : 0);
+		for (; it != this->held.end() && it->first < end; ++it)
+		{
+			if (it->second.end > begin && !(shared && it->second.shared)) return true;
+		}
+
+		return false;
+	}
+
+public:
+
+	interval_ranges() = default;
+	interval_ranges(const interval_ranges& other) = delete;
+	interval_ranges& operator=(const interval_ranges& other) = delete;
+
+	/**
+	 * \brief	the range held by a range lock.
+	 */
+	struct ticket
+	{
+		range_set::iterator at;
+		bool empty;
+	};
+
+	ticket lock(const std::size_t begin, const std::size_t end, std::size_t, const bool shared)
+	{
+		if (begin == end) return ticket{ range_set::iterator(), true };
+
+		for (;;)
+		{
+			this->guard.lock();
+			const std::uint32_t seen = this->released.load(std::memory_order_relaxed);
+			if (!overlaps(begin, end, shared))
+			{
+				try
+				{
+					const ticket held{ this->held.emplace(begin, held_range{ end, shared }), false };
+					this->longest = std::max(this->longest, end - begin);
+					this->guard.unlock();
+					return held;
+				}
+				catch (...)
+				{
+					this->guard.unlock();
+					throw;
+				}
+			}
+
+			this->guard.unlock();
+			dmut_detail::wait(this->released, seen);
+		}
+	}
+
+	void unlock(const ticket& held) noexcept
+	{
+		if (held.empty) return;
+
+		this->guard.lock();
+		this->held.erase(held.at);
+		if (this->held.empty()) this->longest = 0;
+
+		this->released.fetch_add(1, std::memory_order_release);
+		this->guard.unlock();
+
+		dmut_detail::wake_all(this->released);
+	}
+};
+
+template <typename Container, typename Ranges>
+class range_dmut;
+
+/**
+ * \brief	a lock on a range of the elements of a range_dmut, accessed as a span.
+ *			the lock is released once the object is destroyed or unlocked,
+ *			much like a dlock.
+ * \tparam T the type of the elements, const for a readers lock.
+ * \tparam M the range_dmut that issued the lock.
+ */
+template <typename T, typename M>
+class drange
+{
+	M *owner;
+	std::span<T> elements;
+	typename M::ticket held;
+
+	friend M;
+
+	drange(M *owner, const std::span<T> elements, const typename M::ticket& held) noexcept
+		: owner(owner), elements(elements), held(held) {}
+
+public:
+
+	drange() noexcept : owner(nullptr), held() {}
+	drange(drange&& other) noexcept
+		: owner(std::exchange(other.owner, nullptr)), elements(std::exchange(other.elements, std::span<T>())), held(other.held) {}
+	drange(const drange& other) = delete;
+
+	drange& operator=(const drange& other) = delete;
+	drange& operator=(drange&& other) noexcept
+	{
+		if (this == &other) return *this;
+
+		// the lock currently held by this object is released before taking over.
+		unlock();
+		this->owner = std::exchange(other.owner, nullptr);
+		this->elements = std::exchange(other.elements, std::span<T>());
+		this->held = other.held;
+
+		return *this;
+	}
+
+	~drange() { unlock(); }
+
+	/**
+	 * \brief	the locked elements, valid for as long as the lock is held.
+	 */
+	std::span<T> span() const noexcept { return this->elements; }
+
+	T& operator[](const std::size_t index) const noexcept { return this->elements[index]; }
+	std::size_t size() const noexcept { return this->elements.size(); }
+	auto begin() const noexcept { return this->elements.begin(); }
+	auto end() const noexcept { return this->elements.end(); }
+
+	/**
+	 * \brief	releases the lock on the range rendering this object useless.
+	 */
+	void unlock() noexcept
+	{
+		if (this->owner != nullptr) this->owner->release_range(this->held);
+		this->owner = nullptr;
+		this->elements = std::span<T>();
+	}
+};
+
+/**
+ * \brief	A dmut over a contiguous container (such as std::vector) whose elements
+ *			can be locked by ranges, writers of ranges that do not overlap run in
+ *			parallel instead of serializing on a single lock of the whole container.
+ *
+ *			*	lock_range / peek_range lock a range of elements for writing or reading,
+ *				the range is accessed through a drange, a span of the locked elements.
+ *
+ *			*	lock locks the whole container, it excludes every range lock so the
+ *				container itself can be modified (resized for instance), the size of the
+ *				container never changes while a range lock is held.
+ *				a pending lock of the whole container keeps new range locks out, so it
+ *				is not starved by range locks coming and going.
+ *
+ *			notes:
+ *
+ *			*	the Ranges policy decides how ranges exclude each other, see striped_ranges
+ *				(the default) and interval_ranges.
+ *
+ *			*	a thread holding a range lock should not lock another range of the same
+ *				container, overlapping or not, nor call size, the locks may be waiting on
+ *				each other or on a pending lock of the whole container.
+ *
+ * \tparam Container the contiguous container of the elements.
+ * \tparam Ranges the range policy.
+ */
+template <typename Container, typename Ranges = striped_ranges<>>
+class range_dmut
+{
+public:
+
+	typedef std::remove_reference_t<decltype(*std::data(std::declval<Container&>()))> element_type;
+	typedef typename Ranges::ticket ticket;
+
+	typedef drange<element_type, range_dmut> range_write_lock;
+	typedef drange<const element_type, range_dmut> range_read_lock;
+	typedef dlock<Container, range_dmut> write_lock;
+
+private:
+
+	// held shared by every range lock and exclusively by a lock of the whole container,
+	// which is preferred so a steady stream of range locks cannot starve it.
+	alignas(dmut_detail::CACHE_LINE) writer_preferring_lock structure;
+
+	Ranges ranges;
+
+	Container data;
+
+	template <typename, typename, LOCK_TYPE>
+	friend class dlock;
+	template <typename, typename>
+	friend class drange;
+
+	/**
+	 * \param	whole whether to lock every element, the end is then the size of the container.
+	 */
+	template <typename T>
+	drange<T, range_dmut> acquire_range(const std::size_t begin, std::size_t end, const bool shared, const bool whole = false)
+	{
+		this->structure.lock_shared();
+
+		const std::size_t size = std::size(this->data);
+		if (whole) end = size;
+
+		if (begin > end || end > size)
+		{
+			this->structure.unlock_shared();
+			throw std::out_of_range("range_dmut: the range is outside of the container");
+		}
+
+		try
+		{
+			const ticket held = this->ranges.lock(begin, end, size, shared);
+			return drange<T, range_dmut>(this, std::span<T>(std::data(this->data) + begin, end - begin), held);
+		}
+		catch (...)
+		{
+			this->structure.unlock_shared();
+			throw;
+		}
+	}
+
+	void release_range(const ticket& held) noexcept
+	{
+		this->ranges.unlock(held);
+		this->structure.unlock_shared();
+	}
+
+	/**
+	 * \brief	callback for releasing locks of the whole container.
+	 */
+	template <LOCK_TYPE TYPE>
+	void on_release() noexcept
+	{
+		static_assert(TYPE == WRITER_LOCK, "a range_dmut only issues writers locks on the whole container");
+		this->structure.unlock();
+	}
+
+	Container* locked_data() noexcept { return &this->data; }
+
+public:
+
+	explicit range_dmut(Container&& value) : data(std::move(value)) {}
+	explicit range_dmut(const Container& value) : data(value) {}
+
+	/**
+	 * \brief	constructs a range_dmut, constructing the container in place.
+	 * \param	args the parameters required to construct the container.
+	 */
+	template <typename ...U>
+	explicit range_dmut(std::in_place_t, U&& ...args) : data(std::forward<U>(args)...) {}
+
+	range_dmut(const range_dmut& other) = delete;
+	range_dmut(range_dmut&& other) = delete;
+
+	~range_dmut()
+	{
+		// this will ensure that the container cannot be destroyed while
+		// someone holds a lock on its elements.
+		std::lock_guard<writer_preferring_lock> guard(this->structure);
+	}
+
+	range_dmut& operator=(const range_dmut& other) = delete;
+	range_dmut& operator=(range_dmut&& other) = delete;
+
+	/**
+	 * \brief	requests a writers lock on the elements in [begin, end).
+	 *			if someone else is holding a lock overlapping the range (as decided by
+	 *			the range policy) or a lock on the whole container, this method will
+	 *			wait until the range is available.
+	 * \param	begin the index of the first element of the range.
+	 * \param	end the index past the last element of the range.
+	 * \return	the lock on the range, a span of the elements with ability to read and write to them.
+	 * \throws	std::out_of_range if the range is not inside the container.
+	 */
+	range_write_lock lock_range(const std::size_t begin, const std::size_t end)
+	{
+		return acquire_range<element_type>(begin, end, false);
+	}
+
+	/**
+	 * \brief	requests a readers lock on the elements in [begin, end),
+	 *			readers of overlapping ranges share them, see lock_range.
+	 * \param	begin the index of the first element of the range.
+	 * \param	end the index past the last element of the range.
+	 * \return	the lock on the range, a span of the elements as const.
+	 * \throws	std::out_of_range if the range is not inside the container.
+	 */
+	range_read_lock peek_range(const std::size_t begin, const std::size_t end)
+	{
+		return acquire_range<const element_type>(begin, end, true);
+	}
+
+	/**
+	 * \brief	requests a readers lock on all the elements, see peek_range.
+	 */
+	range_read_lock peek() { return acquire_range<const element_type>(0, 0, true, true); }
+
+	/**
+	 * \brief	requests a writers lock on the whole container.
+	 *			if someone else is holding any lock on the container or its elements
+	 *			this method will wait until every lock is released.
+	 * \return	the lock on the container with ability to read and write to it.
+	 */
+	write_lock lock()
+	{
+		this->structure.lock();
+		return write_lock(this);
+	}
+
+	/**
+	 * \brief	the number of elements, which may change once no lock is held.
+	 */
+	std::size_t size()
+	{
+		this->structure.lock_shared();
+		const std::size_t size = std::size(this->data);
+		this->structure.unlock_shared();
+
+		return size;
+	}
+};
+
+
+#endif
@@ -0,0 +1,298 @@
+#ifndef RCU_DMUT_H
+#define RCU_DMUT_H
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <utility>
+
+#include "dmut.h"
+
+
+/**
+ * \brief	Read-Copy-Update Data Oriented Mutex, readers and writers never
+ *			block each other, instead of guarding a single instance of the data
+ *			the mutex holds the current version (snapshot) of the data.
+ *
+ *			*	a readers lock (peek) holds a reference to the snapshot that was
+ *				current when it was acquired, the snapshot is immutable and stays
+ *				alive for as long as some lock refers to it.
+ *
+ *			*	a writers lock (lock) holds a private copy of the current snapshot,
+ *				when the lock is released the copy is published atomically and becomes
+ *				the current snapshot, readers that acquire a lock from this point see
+ *				the new version while readers holding the old version are unaffected.
+ *
+ *			writers still exclude each other, so every write is applied
+ *			on top of the previous one and no update is lost.
+ *
+ *			notes:
+ *
+ *			*	old snapshots are reference counted and reclaimed once the last reader
+ *				referring to them leaves, the short window between loading the current
+ *				snapshot and counting the reference is protected by an epoch, writers
+ *				wait for the readers inside that window before dropping the mutex's
+ *				own reference to the snapshot they replaced.
+ *
+ *			*	every write copies the data, which makes the mutex a good fit for data
+ *				that is read for long periods of time and written rarely.
+ *
+ * \tparam T The type of data that the mutex guards, must be copy constructible
+ *			in order to use lock().
+ */
+template <typename T>
+class rcu_dmut
+{
+	/*
+	 *	A snapshot is the owner of readers locks, releasing a readers lock
+	 *	simply drops its reference to the snapshot.
+	 *	the rcu_dmut holds a reference to the current snapshot as well,
+	 *	which is dropped when a newer snapshot replaces it.
+	 */
+	struct snapshot
+	{
+		std::atomic<std::size_t> refs;
+		T data;
+
+		template <typename ...U>
+		explicit snapshot(U&& ...args) : refs(1), data(std::forward<U>(args)...) {}
+		snapshot(const snapshot& other) = delete;
+		snapshot(snapshot&& other) = delete;
+
+		snapshot& operator=(const snapshot& other) = delete;
+		snapshot& operator=(snapshot&& other) = delete;
+
+		void acquire() noexcept { this->refs.fetch_add(1, std::memory_order_relaxed); }
+
+		void release() noexcept
+		{
+			if (this->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) delete this;
+		}
+
+		template <LOCK_TYPE TYPE>
+		void on_release() noexcept { release(); }
+
+		const T* locked_data() const noexcept { return &this->data; }
+	};
+
+	std::atomic<snapshot*> current;
+
+	// readers between loading the current snapshot and counting their
+	// reference to it, split by the parity of the epoch they entered in.
+	std::atomic<std::uint64_t> epoch;
+	std::atomic<std::size_t> pins[2];
+
+	// excludes writers from each other, readers never touch it.
+	reader_preferring_lock writers;
+
+	// the copy being written by the current writer.
+	snapshot *draft;
+
+	friend dlock<T, rcu_dmut>;
+
+	/**
+	 * \brief	acquires a reference to the current snapshot.
+	 * \return	the current snapshot, the caller is responsible for
+	 *			releasing the reference.
+	 */
+	snapshot* acquire_current() noexcept
+	{
+		for (;;)
+		{
+			const std::uint64_t e = this->epoch.load();
+			std::atomic<std::size_t>& pin = this->pins[e & 1];
+
+			pin.fetch_add(1);
+
+			// a writer that moved to the next epoch will not wait for this pin,
+			// pin again on the current parity.
+			if (this->epoch.load() != e)
+			{
+				pin.fetch_sub(1, std::memory_order_release);
+				continue;
+			}
+
+			snapshot *s = this->current.load();
+			s->acquire();
+
+			pin.fetch_sub(1, std::memory_order_release);
+			return s;
+		}
+	}
+
+	/**
+	 * \brief	replaces the current snapshot, once no reader can still be
+	 *			acquiring a reference to the replaced snapshot the mutex's
+	 *			reference to it is released.
+	 * \param	next the snapshot to publish.
+	 */
+	void publish(snapshot *next) noexcept
+	{
+		snapshot *previous = this->current.exchange(next);
+
+		// readers entering from now on can only load the new snapshot,
+		// wait for the readers that entered in the old epoch.
+		const std::uint64_t e = this->epoch.fetch_add(1);
+		while (this->pins[e & 1].load() != 0) std::this_thread::yield();
+
+		previous->release();
+	}
+
+	/**
+	 * \brief	copies the current snapshot into a new draft,
+	 *			should be called once the writers lock is acquired.
+	 * \return	a writers lock on the draft.
+	 */
+	dlock<T, rcu_dmut> begin_write()
+	{
+		try
+		{
+			this->draft = new snapshot(this->current.load(std::memory_order_relaxed)->data);
+		}
+		catch (...)
+		{
+			this->writers.unlock();
+			throw;
+		}
+
+		return dlock<T, rcu_dmut>(this);
+	}
+
+	/**
+	 * \brief	callback for releasing writers locks, publishes the written copy.
+	 * \tparam	TYPE the type of the expiring lock.
+	 */
+	template <LOCK_TYPE TYPE>
+	void on_release() noexcept
+	{
+		static_assert(TYPE == WRITER_LOCK, "an rcu_dmut only issues writers locks, readers locks are issued by snapshots");
+
+		publish(this->draft);
+		this->draft = nullptr;
+		this->writers.unlock();
+	}
+
+	/**
+	 * \brief	the data writers locks refer to, the draft of the current writer.
+	 */
+	T* locked_data() noexcept { return &this->draft->data; }
+
+public:
+
+	typedef dlock<T, rcu_dmut> write_lock;
+	typedef dlock<const T, snapshot> read_lock;
+
+	explicit rcu_dmut(T&& value) : current(new snapshot(std::move(value))), epoch(0), pins{ {0}, {0} }, draft(nullptr) {}
+	explicit rcu_dmut(const T& value) : current(new snapshot(value)), epoch(0), pins{ {0}, {0} }, draft(nullptr) {}
+	rcu_dmut(const rcu_dmut& other) = delete;
+	rcu_dmut(rcu_dmut&& other) = delete;
+
+	~rcu_dmut()
+	{
+		// readers might still hold the current snapshot, they will reclaim it.
+		std::lock_guard<reader_preferring_lock> guard(this->writers);
+		this->current.load()->release();
+	}
+
+	rcu_dmut& operator=(const rcu_dmut& other) = delete;
+	rcu_dmut& operator=(rcu_dmut&& other) = delete;
+
+	/**
+	 * \brief	requests a writers lock on a copy of the current snapshot.
+	 *			if someone else is holding a writers lock this method will
+	 *			wait until the lock is available, readers never delay it.
+	 *			the copy is published once the lock is released.
+	 * \return the lock on the copy with ability to read and write to it.
+	 */
+	write_lock lock()
+	{
+		this->writers.lock();
+		return begin_write();
+	}
+
+	/**
+	 * \brief	requests a writers lock on a copy of the current snapshot.
+	 *			if someone else is already holding a writers lock
+	 *			the lock will not be acquired and the method will return.
+	 * \return a pair of bool and dlock, the bool represents whether or not
+	 *			the lock was acquired and the dlock is the lock itself.
+	 *			in case the lock is not acquired a dlock pointing to null will be returned.
+	 */
+	std::pair<bool, write_lock> try_lock()
+	{
+		if (this->writers.try_lock())
+			return std::make_pair(true, begin_write());
+
+		return std::make_pair(false, write_lock());
+	}
+
+	/**
+	 * \brief	replaces the data with a new value without copying the current snapshot.
+	 *			if someone else is holding a writers lock this method will
+	 *			wait until the lock is available.
+	 * \param	value the new value of the data.
+	 */
+	void replace(T&& value)
+	{
+		std::lock_guard<reader_preferring_lock> guard(this->writers);
+		publish(new snapshot(std::move(value)));
+	}
+
+	/**
+	 * \brief	calls fn with a copy of the current snapshot while holding a writers lock,
+	 *			the copy is published once fn returns, see lock().
+	 * \param	fn the function to call with the copy.
+	 * \return	the result of calling fn.
+	 */
+	template <typename F>
+	decltype(auto) with_lock(F&& fn)
+	{
+		const write_lock lock = this->lock();
+		return std::forward<F>(fn)(*lock);
+	}
+
+	/**
+	 * \brief	calls fn with the current snapshot, the method never blocks.
+	 * \param	fn the function to call with the snapshot, the snapshot is const.
+	 * \return	the result of calling fn.
+	 */
+	template <typename F>
+	decltype(auto) with_peek(F&& fn)
+	{
+		const read_lock lock = peek();
+		return std::forward<F>(fn)(*lock);
+	}
+
+	/**
+	 * \brief	requests a readers lock on the current snapshot,
+	 *			the method never blocks.
+	 * \return the lock on the snapshot as const, meaning the data can only be read.
+	 */
+	read_lock peek() noexcept
+	{
+		snapshot *s = acquire_current();
+		return read_lock(s);
+	}
+
+	/**
+	 * \brief	same as peek(), provided so the rcu_dmut can replace a dmut,
+	 *			acquiring a readers lock always succeeds.
+	 */
+	std::pair<bool, read_lock> try_peek() noexcept { return std::make_pair(true, peek()); }
+};
+
+/**
+ * \brief Creates an rcu_dmut, the first snapshot is constructed in place.
+ * \tparam T the type of data the mutex should guard.
+ * \tparam U the parameter types required to construct the object.
+ * \param args the parameters required to construct the object.
+ * \return an rcu_dmut holding the newly constructed object of type T as its snapshot.
+ */
+template <typename T, typename ...U>
+rcu_dmut<T> make_rcu_dmut(U&& ...args)
+{
+	return rcu_dmut<T>(T(std::forward<U>(args)...));
+}
+
+
+#endif
@@ -0,0 +1,566 @@
+#ifndef SHM_DMUT_H
+#define SHM_DMUT_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include "dmut.h"
+
+#if defined(__linux__)
+
+#include <cerrno>
+#include <climits>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+/**
+ * \brief	Shared Memory Data Oriented Mutex, the data and the lock guarding it are
+ *			placed in a named shared memory object (shm_open) mapped by every process
+ *			opening the shm_dmut, so processes share a single instance of the data
+ *			instead of holding a copy each, and the data outlives the processes using it.
+ *
+ *			*	the first process opening a name creates the shared memory object and
+ *				constructs the data, the rest of the processes map the existing data
+ *				and never construct it again.
+ *
+ *			*	the data is accessed through dlocks, just like the data of a dmut,
+ *				lock and peek acquire a writers or a readers lock shared by every process.
+ *
+ *			the lock is robust to processes dying while holding it, a writers lock held
+ *			by a dead process is recovered by the next process acquiring a lock, and the
+ *			readers locks held by a dead process are dropped by the next writer.
+ *			locks are owned by processes rather than by threads, so a dlock may be
+ *			released by another thread of the process that acquired it.
+ *			the data a dead writer was writing may be half written, which is reported
+ *			by abandoned() until mark_consistent() is called.
+ *
+ *			notes:
+ *
+ *			*	a process is told dead by its pid, the lock should not be held by a process
+ *				whose pid might have been reused, and a process should open the shm_dmut
+ *				itself rather than inherit it from its parent through fork.
+ *
+ *			*	the shared memory object outlives the processes using it, it is only
+ *				destroyed by remove(name) once no process maps it anymore.
+ *
+ *			*	only available on linux.
+ *
+ * \tparam T the type of data that the mutex guards, it is mapped at a different
+ *			address by every process so it must be trivially copyable, holding
+ *			no pointers and no resources of a single process.
+ * \tparam SLOTS the number of reader slots, the readers of every process count
+ *			themselves in slots of their own so the readers of a dead process can be told apart.
+ */
+template <typename T, std::size_t SLOTS = 64>
+class shm_dmut
+{
+	static_assert(std::is_trivially_copyable<T>::value, "the data of a shm_dmut is shared by processes as is, it must be trivially copyable");
+	static_assert(SLOTS > 0, "shm_dmut requires at least one reader slot");
+
+	/*
+	 *	The beginning of the shared memory object, shared by every process mapping it.
+	 *	words waited on by several processes use shared futexes.
+	 */
+	struct header
+	{
+		static constexpr std::uint64_t MAGIC = 0x6d68735f74756d64ull;
+
+		std::uint64_t magic;
+		std::uint64_t data_size;
+		std::uint64_t slots;
+
+		// the pid of the process constructing the data.
+		std::atomic<std::uint32_t> creator;
+
+		// set once the data is constructed.
+		std::atomic<std::uint32_t> ready{0};
+
+		// set once a writer died while holding the lock.
+		std::atomic<std::uint32_t> abandoned{0};
+
+		// the pid of the process holding (or acquiring) the writers lock, writers
+		// exclude each other by setting it and readers wait for as long as it is set.
+		alignas(dmut_detail::CACHE_LINE) std::atomic<std::uint32_t> writer{0};
+
+		// set by a writer parked waiting for the readers to leave, cleared
+		// by the leaving reader waking it.
+		std::atomic<std::uint32_t> draining{0};
+
+		// the readers of a single process, its pid in the upper half and their number in the lower.
+		struct alignas(dmut_detail::CACHE_LINE) slot
+		{
+			std::atomic<std::uint64_t> readers{0};
+		};
+
+		slot readers[SLOTS];
+
+		header() noexcept : magic(MAGIC), data_size(sizeof(T)), slots(SLOTS), creator(static_cast<std::uint32_t>(getpid())) {}
+	};
+
+	static constexpr std::size_t DATA_OFFSET = (sizeof(header) + alignof(T) - 1) / alignof(T) * alignof(T);
+	static constexpr std::size_t REGION_SIZE = DATA_OFFSET + sizeof(T);
+
+	// how long a waiting reader sleeps before checking whether the writer is still alive,
+	// and a parked writer before checking whether the readers are.
+	static constexpr long LIVENESS_CHECK_NS = 10000000;
+
+	// the pause instructions a writer spends waiting for the readers to leave before it parks.
+	static constexpr std::uint32_t DRAIN_SPIN_BUDGET = 1024;
+
+	// how long an opening process waits for the creator to size and map the object,
+	// the creator may have died before it could, leaving a name no process can open.
+	static constexpr std::chrono::seconds OPEN_TIMEOUT{1};
+
+	void *region;
+	header *shared;
+	T *data;
+
+	std::uint32_t self;
+
+	template <typename, typename, LOCK_TYPE>
+	friend class dlock;
+
+	static void wait_shared(std::atomic<std::uint32_t>& word, const std::uint32_t value) noexcept
+	{
+		timespec timeout{ 0, LIVENESS_CHECK_NS };
+		dmut_detail::futex(word, FUTEX_WAIT, value, &timeout);
+	}
+
+	static void wake_shared(std::atomic<std::uint32_t>& word) noexcept { dmut_detail::futex(word, FUTEX_WAKE, INT_MAX, nullptr); }
+
+	static bool alive(const std::uint32_t pid) noexcept
+	{
+		return kill(static_cast<pid_t>(pid), 0) == 0 || errno == EPERM;
+	}
+
+	static std::uint64_t readers_of(const std::uint32_t pid, const std::uint32_t count) noexcept
+	{
+		return count == 0 ? 0 : (static_cast<std::uint64_t>(pid) << 32) | count;
+	}
+
+	/**
+	 * \brief	maps the shared memory object of a name, creating it if it does not exist.
+	 * \return	whether the object was created by the calling process.
+	 */
+	bool map(const std::string& name, const std::chrono::steady_clock::time_point deadline)
+	{
+		bool created = true;
+		int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+		if (fd == -1 && errno == EEXIST)
+		{
+			created = false;
+			fd = shm_open(name.c_str(), O_RDWR, 0600);
+		}
+
+		if (fd == -1) throw std::system_error(errno, std::generic_category(), "shm_dmut: shm_open");
+
+		const auto fail = [&](const char *what) {
+			const int error = errno;
+			close(fd);
+			if (created) shm_unlink(name.c_str());
+			throw std::system_error(error, std::generic_category(), what);
+		};
+
+		if (created)
+		{
+			if (ftruncate(fd, static_cast<off_t>(REGION_SIZE)) == -1) fail("shm_dmut: ftruncate");
+		}
+		else
+		{
+			// the creator sizes the object right after creating it.
+			struct stat status;
+			for (;;)
+			{
+				if (fstat(fd, &status) == -1) fail("shm_dmut: fstat");
+				if (status.st_size != 0) break;
+
+				if (std::chrono::steady_clock::now() >= deadline)
+				{
+					close(fd);
+					throw std::runtime_error("shm_dmut: the shared memory object was never sized, its creator may have died, see remove");
+				}
+				std::this_thread::yield();
+			}
+
+			if (static_cast<std::size_t>(status.st_size) != REGION_SIZE)
+			{
+				close(fd);
+				throw std::runtime_error("shm_dmut: the shared memory object holds data of a different type");
+			}
+		}
+
+		this->region = mmap(nullptr, REGION_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (this->region == MAP_FAILED) fail("shm_dmut: mmap");
+
+		close(fd);
+		return created;
+	}
+
+	/**
+	 * \brief	takes the writers lock over from a writer that died while holding it.
+	 * \param	dead the pid of the dead writer.
+	 * \param	next the pid of the next writer, or 0 to release the lock.
+	 * \return	whether the lock was taken over, another process may have done it first.
+	 */
+	bool recover(std::uint32_t dead, const std::uint32_t next) noexcept
+	{
+		if (!this->shared->writer.compare_exchange_strong(dead, next, std::memory_order_seq_cst)) return false;
+
+		// the data the dead writer was writing may be half written.
+		this->shared->abandoned.store(1, std::memory_order_relaxed);
+		if (next == 0) wake_shared(this->shared->writer);
+		return true;
+	}
+
+	/**
+	 * \brief	counts a reader of the calling process in a slot, starting
+	 *			at the slot of the calling thread.
+	 */
+	void enter_slot() noexcept
+	{
+		const std::size_t first = std::hash<std::thread::id>()(std::this_thread::get_id()) % SLOTS;
+		for (;;)
+		{
+			for (std::size_t i = 0; i < SLOTS; ++i)
+			{
+				std::atomic<std::uint64_t>& slot = this->shared->readers[(first + i) % SLOTS].readers;
+				std::uint64_t readers = slot.load(std::memory_order_relaxed);
+
+				while (readers == 0 || static_cast<std::uint32_t>(readers >> 32) == this->self)
+				{
+					if (slot.compare_exchange_weak(readers, readers_of(this->self, static_cast<std::uint32_t>(readers) + 1), std::memory_order_seq_cst))
+						return;
+				}
+			}
+
+			// every slot is taken by other processes.
+			std::this_thread::yield();
+		}
+	}
+
+	/**
+	 * \brief	uncounts a reader of the calling process, waking the writer
+	 *			if it parked waiting for the readers to leave.
+	 */
+	void leave_slot() noexcept
+	{
+		const std::size_t first = std::hash<std::thread::id>()(std::this_thread::get_id()) % SLOTS;
+		for (std::size_t i = 0; i < SLOTS; ++i)
+		{
+			std::atomic<std::uint64_t>& slot = this->shared->readers[(first + i) % SLOTS].readers;
+			std::uint64_t readers = slot.load(std::memory_order_relaxed);
+
+			// any slot of the process will do, its readers are interchangeable.
+			while (readers != 0 && static_cast<std::uint32_t>(readers >> 32) == this->self)
+			{
+				if (!slot.compare_exchange_weak(readers, readers_of(this->self, static_cast<std::uint32_t>(readers) - 1), std::memory_order_seq_cst))
+					continue;
+
+				// the slot is cleared seq_cst before loading the writer word, and a parking writer sets
+				// draining before loading the slots, so either the writer sees the slot cleared
+				// or the reader sees draining set.
+				if (this->shared->writer.load(std::memory_order_seq_cst) != 0 && this->shared->draining.exchange(0, std::memory_order_seq_cst) != 0)
+					wake_shared(this->shared->draining);
+				return;
+			}
+		}
+	}
+
+	/**
+	 * \brief	whether no reader (of a live process) holds the lock,
+	 *			the slots of dead processes are cleared on the way.
+	 *			the slots are loaded seq_cst after the writer word was set,
+	 *			as the readers set their slot before loading the writer word.
+	 */
+	bool drained() noexcept
+	{
+		for (std::size_t i = 0; i < SLOTS; ++i)
+		{
+			std::atomic<std::uint64_t>& slot = this->shared->readers[i].readers;
+			std::uint64_t readers = slot.load(std::memory_order_seq_cst);
+			if (readers == 0) continue;
+
+			if (alive(static_cast<std::uint32_t>(readers >> 32)) || !slot.compare_exchange_strong(readers, 0, std::memory_order_seq_cst))
+				return false;
+		}
+
+		return true;
+	}
+
+	/**
+	 * \brief	sets the writer word to the calling process, taking it over from a dead writer.
+	 *			readers that see the writer back out, readers that were seen are waited for.
+	 * \return	false if the word is held and blocking was not requested.
+	 */
+	bool acquire_writers(const bool block) noexcept
+	{
+		for (;;)
+		{
+			std::uint32_t writer = 0;
+			if (this->shared->writer.compare_exchange_strong(writer, this->self, std::memory_order_seq_cst)) return true;
+
+			if (!alive(writer))
+			{
+				if (recover(writer, this->self)) return true;
+				continue;
+			}
+
+			if (!block) return false;
+			wait_shared(this->shared->writer, writer);
+		}
+	}
+
+	void release_writers() noexcept
+	{
+		this->shared->writer.store(0, std::memory_order_release);
+		wake_shared(this->shared->writer);
+	}
+
+	void acquire_write()
+	{
+		acquire_writers(true);
+
+		// readers leave quickly, so the writer spins a little before parking, a parked
+		// writer wakes up on its own to drop the readers of processes that died.
+		dmut_detail::backoff backoff;
+		for (std::uint32_t spent = 0; !drained();)
+		{
+			if (spent < DRAIN_SPIN_BUDGET)
+			{
+				spent += backoff.pause();
+				continue;
+			}
+
+			this->shared->draining.store(1, std::memory_order_seq_cst);
+			if (drained()) break;
+			wait_shared(this->shared->draining, 1);
+		}
+
+		this->shared->draining.store(0, std::memory_order_relaxed);
+	}
+
+	bool try_acquire_write()
+	{
+		if (!acquire_writers(false)) return false;
+		if (drained()) return true;
+
+		release_writers();
+		return false;
+	}
+
+	/**
+	 * \param	block whether to wait for the writer holding the lock.
+	 */
+	bool acquire_read(const bool block)
+	{
+		for (;;)
+		{
+			enter_slot();
+
+			// the slot was set seq_cst before loading the writer word seq_cst, and the writer sets
+			// the word before loading the slots, so either side sees the other, and
+			// the load acquires the data released by the last writer.
+			const std::uint32_t writer = this->shared->writer.load(std::memory_order_seq_cst);
+			if (writer == 0) return true;
+
+			leave_slot();
+			if (!block) return false;
+
+			wait_shared(this->shared->writer, writer);
+			if (!alive(writer)) recover(writer, 0);
+		}
+	}
+
+	template <LOCK_TYPE TYPE>
+	void on_release() noexcept
+	{
+		static_assert(TYPE != UPGRADE_LOCK, "a shm_dmut does not issue upgradeable locks");
+
+		if constexpr (TYPE == WRITER_LOCK) release_writers();
+		else leave_slot();
+	}
+
+	T* locked_data() const noexcept { return this->data; }
+
+public:
+
+	typedef dlock<T, shm_dmut> write_lock;
+	typedef dlock<const T, shm_dmut> read_lock;
+
+	/**
+	 * \brief	opens the shm_dmut of a name, if no shared memory object of that name
+	 *			exists it is created and the data is constructed in place.
+	 * \param	name the name of the shared memory object, such as "/table".
+	 * \param	args the parameters required to construct the data, only used
+	 *			by the process creating the object.
+	 * \throws	std::system_error if the object cannot be opened or mapped,
+	 *			std::runtime_error if it holds data of a different type, or if its
+	 *			creator died (or failed to size it in time) before constructing the data.
+	 */
+	template <typename ...U>
+	explicit shm_dmut(const std::string& name, U&& ...args) : region(nullptr), shared(nullptr), data(nullptr), self(static_cast<std::uint32_t>(getpid()))
+	{
+		const auto deadline = std::chrono::steady_clock::now() + OPEN_TIMEOUT;
+		const bool created = map(name, deadline);
+		this->shared = static_cast<header*>(this->region);
+		this->data = reinterpret_cast<T*>(static_cast<std::byte*>(this->region) + DATA_OFFSET);
+
+		if (created)
+		{
+			try
+			{
+				new (this->region) header();
+				new (this->data) T(std::forward<U>(args)...);
+			}
+			catch (...)
+			{
+				munmap(this->region, REGION_SIZE);
+				shm_unlink(name.c_str());
+				throw;
+			}
+
+			this->shared->ready.store(1, std::memory_order_release);
+			wake_shared(this->shared->ready);
+			return;
+		}
+
+		// the creator may take as long as it needs to construct the data, as long as it is alive.
+		while (this->shared->ready.load(std::memory_order_acquire) == 0)
+		{
+			const std::uint32_t creator = this->shared->creator.load(std::memory_order_relaxed);
+			if (creator != 0 ? !alive(creator) : std::chrono::steady_clock::now() >= deadline)
+			{
+				munmap(this->region, REGION_SIZE);
+				throw std::runtime_error("shm_dmut: the creator of the shared memory object died before constructing the data, see remove");
+			}
+
+			wait_shared(this->shared->ready, 0);
+		}
+
+		if (this->shared->magic != header::MAGIC || this->shared->data_size != sizeof(T) || this->shared->slots != SLOTS)
+		{
+			munmap(this->region, REGION_SIZE);
+			throw std::runtime_error("shm_dmut: the shared memory object holds data of a different type");
+		}
+	}
+
+	shm_dmut(const shm_dmut& other) = delete;
+	shm_dmut(shm_dmut&& other) = delete;
+
+	/**
+	 * \brief	unmaps the data, which stays in the shared memory object, see remove.
+	 */
+	~shm_dmut() { munmap(this->region, REGION_SIZE); }
+
+	shm_dmut& operator=(const shm_dmut& other) = delete;
+	shm_dmut& operator=(shm_dmut&& other) = delete;
+
+	/**
+	 * \brief	removes the shared memory object of a name, processes mapping it keep
+	 *			their mapping and the object is destroyed once the last one unmaps it.
+	 * \return	whether the object existed.
+	 */
+	static bool remove(const std::string& name) noexcept { return shm_unlink(name.c_str()) == 0; }
+
+	/**
+	 * \brief	requests a writers lock on the data, excluding every process.
+	 *			if someone else is holding some lock on the data
+	 *			this method will wait until the lock is available.
+	 * \return the lock on the data with ability to read and write to it.
+	 */
+	write_lock lock()
+	{
+		acquire_write();
+		return write_lock(this);
+	}
+
+	/**
+	 * \brief	requests a writers lock on the data, if someone else is holding
+	 *			some lock on the data the lock will not be acquired.
+	 * \return a pair of bool and dlock, the bool represents whether or not
+	 *			the lock was acquired, see dmut::try_lock.
+	 */
+	std::pair<bool, write_lock> try_lock()
+	{
+		if (try_acquire_write()) return std::make_pair(true, write_lock(this));
+		return std::make_pair(false, write_lock());
+	}
+
+	/**
+	 * \brief	requests a readers lock on the data, shared with the readers of every process.
+	 *			if someone else is holding a writers lock on the data
+	 *			this method will wait until the lock is released.
+	 * \return the lock on the data as const, meaning the data can only be read.
+	 */
+	read_lock peek()
+	{
+		acquire_read(true);
+		return read_lock(this);
+	}
+
+	/**
+	 * \brief	requests a readers lock on the data, if someone else is holding
+	 *			a writers lock the lock will not be acquired.
+	 * \return a pair of bool and dlock, see try_lock.
+	 */
+	std::pair<bool, read_lock> try_peek()
+	{
+		if (acquire_read(false)) return std::make_pair(true, read_lock(this));
+		return std::make_pair(false, read_lock());
+	}
+
+	/**
+	 * \brief	calls fn with the data while holding a writers lock on it.
+	 * \param	fn the function to call with the data.
+	 * \return	the result of calling fn.
+	 */
+	template <typename F>
+	decltype(auto) with_lock(F&& fn)
+	{
+		const write_lock lock = this->lock();
+		return std::forward<F>(fn)(*lock);
+	}
+
+	/**
+	 * \brief	calls fn with the data while holding a readers lock on it.
+	 * \param	fn the function to call with the data, the data is const.
+	 * \return	the result of calling fn.
+	 */
+	template <typename F>
+	decltype(auto) with_peek(F&& fn)
+	{
+		const read_lock lock = peek();
+		return std::forward<F>(fn)(*lock);
+	}
+
+	/**
+	 * \brief	whether a writer died while holding the lock, leaving the data
+	 *			possibly half written.
+	 */
+	bool abandoned() const noexcept { return this->shared->abandoned.load(std::memory_order_relaxed) != 0; }
+
+	/**
+	 * \brief	marks the data as consistent again once it was repaired,
+	 *			should be called while holding a writers lock.
+	 */
+	void mark_consistent() noexcept { this->shared->abandoned.store(0, std::memory_order_relaxed); }
+};
+
+
+#endif
+
+#endif
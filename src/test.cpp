@@ -40,20 +40,21 @@ void transform(dmut<std::vector<int>> &data) {
 
 int main()
 {
-    std::mt19937 rng((std::random_device()()));
-
-    std::uniform_int_distribution<std::mt19937::result_type> generator(INT32_MIN, INT32_MAX);
-
     dmut<std::vector<int>> data = make_dmut<std::vector<int>>(VEC_SIZE);
 
-    auto ptr = data.lock();
-
-    std::generate(ptr->begin(), ptr->end(), [&generator, &rng, &ptr] { return generator(rng); });
+    // the vector is filled by every core under a single lock, every chunk has a generator of its own.
+    thread_pool pool;
+    data.parallel_write([](std::vector<int>::iterator begin, std::vector<int>::iterator end) {
+        std::mt19937 rng((std::random_device()()));
+        std::uniform_int_distribution<std::mt19937::result_type> generator(INT32_MIN, INT32_MAX);
 
-    ptr.unlock();
+        std::generate(begin, end, [&generator, &rng] { return generator(rng); });
+    }, pool);
 
-    std::thread reader1(read, std::ref(data));
-    std::thread reader2(read, std::ref(data));
+    // read is wrapped in a lambda since it would otherwise be ambiguous with ::read
+    // which is visible through the standard headers.
+    std::thread reader1([&data] { read(data); });
+    std::thread reader2([&data] { read(data); });
 
     std::thread transformer1(transform, std::ref(data));
     std::thread transformer2(transform, std::ref(data));
@@ -0,0 +1,86 @@
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <thread>
+
+#include "dmut.h"
+#include "check.h"
+
+/*
+ *	Coroutines waiting for a lock are resumed by whoever makes the lock available,
+ *	not only by the holders of dlocks releasing them.
+ */
+
+struct detached
+{
+	struct promise_type
+	{
+		detached get_return_object() noexcept { return {}; }
+		std::suspend_never initial_suspend() noexcept { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; }
+		void return_void() noexcept {}
+		void unhandled_exception() noexcept { std::terminate(); }
+	};
+};
+
+template <typename M>
+detached read(M& m, std::atomic<bool>& done)
+{
+	auto reader = co_await m.peek_async();
+	done.store(true);
+}
+
+template <typename M>
+detached write(M& m, std::atomic<bool>& done)
+{
+	auto writer = co_await m.lock_async();
+	++*writer;
+	done.store(true);
+}
+
+bool eventually(const std::atomic<bool>& done)
+{
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+	while (!done.load() && std::chrono::steady_clock::now() < deadline) std::this_thread::yield();
+	return done.load();
+}
+
+int main()
+{
+	// a pending writer giving up keeps no coroutine out of the readers held lock.
+	{
+		dmut<int, writer_preferring_lock> m(0);
+		auto reader = m.peek();
+
+		std::thread writer([&m] { CHECK(!m.try_lock_for(std::chrono::milliseconds(200))); });
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+		std::atomic<bool> done{false};
+		read(m, done);
+		CHECK(!done.load());
+
+		writer.join();
+		CHECK(eventually(done));
+	}
+
+	// nor does a dmut moved into another one.
+	{
+		dmut<int> m(0);
+		auto holder = m.lock();
+
+		std::atomic<bool> done{false};
+		write(m, done);
+		CHECK(!done.load());
+
+		std::thread mover([&m] { m = dmut<int>(10); });
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		holder.unlock();
+
+		mover.join();
+		CHECK(eventually(done));
+		CHECK(*m.peek() == 10 || *m.peek() == 11);
+	}
+
+	return 0;
+}
@@ -0,0 +1,33 @@
+#include <type_traits>
+
+#include "dmut.h"
+#include "exclusion.h"
+
+static_assert(std::is_same<basic_dmut<pair>, dmut<pair>>::value);
+static_assert(std::is_same<basic_dmut<pair, writer_preferring_lock, pointer_storage>, dmut<pair, writer_preferring_lock, pointer_storage>>::value);
+static_assert(std::is_same<basic_dmut<pair, reader_preferring_lock, inline_storage<>, lock_profiling>, dmut<pair, profiled_lock<>>>::value);
+
+int main()
+{
+	// a null_lock never excludes anyone, it is only used by a single thread.
+	basic_dmut<pair, null_lock> single;
+	{
+		auto writer = single.lock();
+		++writer->first;
+		auto reader = single.peek();
+		CHECK(reader->first == 1);
+		CHECK(single.try_lock().first);
+	}
+	CHECK(single.try_lock().first);
+
+	// the bookkeeping kept for other threads still runs, by the single thread itself.
+	CHECK(single.submit([](pair& value) { return ++value.second; }) == 1);
+	single.enqueue_write([](pair& value) { ++value.second; });
+	single.lock().unlock();
+	CHECK(single.peek()->second == 2);
+
+	// a profiled basic_dmut still excludes its threads.
+	check_exclusion<basic_dmut<pair, reader_preferring_lock, inline_storage<>, lock_profiling>::lock_type>();
+
+	return 0;
+}
@@ -0,0 +1,37 @@
+#include <thread>
+#include <tuple>
+#include <type_traits>
+
+#include "dmut.h"
+#include "check.h"
+#include "exclusion.h"
+
+// a brdmut issues the same kinds of locks as any other dmut, named by its typedefs.
+static_assert(std::is_same<brdmut<int>::write_lock, dlock<int, brdmut<int>>>::value);
+static_assert(std::is_same<brdmut<int>::read_lock, dlock<const int, brdmut<int>>>::value);
+static_assert(std::is_same<read_lock_t<brdmut<int>>, decltype(std::declval<brdmut<int>&>().peek())>::value);
+static_assert(std::is_same<write_lock_t<brdmut<int>>, decltype(std::declval<brdmut<int>&>().lock())>::value);
+static_assert(std::is_same<read_lock_t<dmut<int>>, dlock<const int>>::value);
+
+int main()
+{
+	check_exclusion<big_reader_lock<>>();
+
+	brdmut<int> counter(1);
+	dmut<int> other(2);
+
+	auto locks = dmut_lock_all(counter, std::as_const(other));
+	static_assert(std::is_same<decltype(locks), std::tuple<write_lock_t<brdmut<int>>, read_lock_t<dmut<int>>>>::value);
+
+	*std::get<0>(locks) += *std::get<1>(locks);
+	on_other_thread([&counter, &other] { CHECK(!counter.try_peek().first); CHECK(other.try_peek().first); CHECK(!other.try_lock().first); });
+	std::get<0>(locks).unlock();
+	std::get<1>(locks).unlock();
+
+	auto readers = dmut_peek_all(counter, other);
+	static_assert(std::is_same<decltype(readers), std::tuple<read_lock_t<brdmut<int>>, read_lock_t<dmut<int>>>>::value);
+	CHECK(*std::get<0>(readers) == 3);
+	on_other_thread([&counter] { CHECK(counter.try_peek().first); CHECK(!counter.try_lock().first); });
+
+	return 0;
+}
@@ -0,0 +1,35 @@
+#ifndef DMUT_TESTS_CHECK_H
+#define DMUT_TESTS_CHECK_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <utility>
+
+/*
+ *	The tests are plain executables run by ctest, a failed check prints
+ *	where it failed and exits with a non zero status, checks are not
+ *	compiled out by NDEBUG like assert would be.
+ */
+#define CHECK(condition)																\
+	do																					\
+	{																					\
+		if (!(condition))																\
+		{																				\
+			std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition);	\
+			std::exit(1);																\
+		}																				\
+	} while (false)
+
+/**
+ * \brief	runs fn on a thread of its own and waits for it, for checking
+ *			what other threads observe while the calling thread holds a lock.
+ */
+template <typename F>
+void on_other_thread(F&& fn)
+{
+	std::thread other(std::forward<F>(fn));
+	other.join();
+}
+
+#endif
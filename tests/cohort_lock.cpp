@@ -0,0 +1,13 @@
+#include "dmut.h"
+#include "exclusion.h"
+
+int main()
+{
+	check_exclusion<cohort_lock<>>();
+
+	// every thread in a single cohort, so writers are handed the lock within it.
+	check_exclusion<cohort_lock<reader_preferring_lock, 1>>();
+	check_exclusion<cohort_lock<writer_preferring_lock, 1, 1>>();
+
+	return 0;
+}
@@ -0,0 +1,141 @@
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "dmut.h"
+#include "check.h"
+
+/*
+ *	A dmut constructs its data in its final storage, from a copy, from a value
+ *	moved in, or from the arguments of the constructor of the data.
+ */
+
+// counts its copies and moves, and keeps what it was constructed from.
+struct counted
+{
+	static inline int copies = 0;
+	static inline int moves = 0;
+
+	std::unique_ptr<int> owned;
+	int *referenced;
+
+	counted(std::unique_ptr<int> owned, int& referenced) : owned(std::move(owned)), referenced(&referenced) {}
+	counted(const counted& other) : owned(std::make_unique<int>(*other.owned)), referenced(other.referenced) { ++copies; }
+	counted(counted&& other) noexcept : owned(std::move(other.owned)), referenced(other.referenced) { ++moves; }
+};
+
+// counts the bytes it holds on to.
+template <typename T>
+struct counting_allocator
+{
+	typedef T value_type;
+
+	std::size_t *live;
+
+	explicit counting_allocator(std::size_t *live) noexcept : live(live) {}
+
+	template <typename U>
+	counting_allocator(const counting_allocator<U>& other) noexcept : live(other.live) {}
+
+	T* allocate(std::size_t n)
+	{
+		*this->live += n * sizeof(T);
+		return std::allocator<T>().allocate(n);
+	}
+
+	void deallocate(T *p, std::size_t n) noexcept
+	{
+		*this->live -= n * sizeof(T);
+		std::allocator<T>().deallocate(p, n);
+	}
+
+	template <typename U>
+	bool operator==(const counting_allocator<U>& other) const noexcept { return this->live == other.live; }
+};
+
+typedef std::vector<int, counting_allocator<int>> counted_vector;
+
+template <typename Storage>
+void check_copy()
+{
+	// the source of a copy is left as it was.
+	const std::string source = "value";
+	dmut<std::string, reader_preferring_lock, Storage> m(source);
+	CHECK(source == "value");
+	CHECK(*m.peek() == "value");
+
+	std::string moved = "moved";
+	dmut<std::string, reader_preferring_lock, Storage> other(std::move(moved));
+	CHECK(*other.peek() == "moved");
+}
+
+template <typename Storage>
+void check_in_place()
+{
+	int referenced = 0;
+	counted::copies = counted::moves = 0;
+
+	dmut<counted, reader_preferring_lock, Storage> m(std::in_place, std::make_unique<int>(7), referenced);
+	CHECK(*m.peek()->owned == 7);
+	CHECK(m.peek()->referenced == &referenced);
+	CHECK(counted::copies == 0 && counted::moves == 0);
+}
+
+int main()
+{
+	check_copy<inline_storage<>>();
+	check_copy<pointer_storage>();
+	check_in_place<inline_storage<>>();
+	check_in_place<pointer_storage>();
+
+	{
+		int referenced = 0;
+		const counted source(std::make_unique<int>(3), referenced);
+		counted::copies = counted::moves = 0;
+
+		dmut<counted> m(source);
+		CHECK(counted::copies == 1 && counted::moves == 0);
+		CHECK(*source.owned == 3);
+		CHECK(*m.peek()->owned == 3);
+	}
+
+	{
+		int referenced = 0;
+		counted::copies = counted::moves = 0;
+
+		auto m = make_dmut<counted>(std::make_unique<int>(5), referenced);
+		auto heap = new_dmut<counted>(std::make_unique<int>(6), referenced);
+		CHECK(*m.peek()->owned == 5 && *heap.peek()->owned == 6);
+		CHECK(counted::copies == 0);
+	}
+
+	// allocated_storage allocates the data through the allocator, which the data receives as well.
+	std::size_t live = 0;
+	{
+		int referenced = 0;
+		const counting_allocator<std::byte> allocator(&live);
+		auto m = allocate_dmut<counted_vector>(allocator, std::size_t(100), 1);
+		CHECK(live == sizeof(counted_vector) + 100 * sizeof(int));
+		CHECK(m.peek()->size() == 100 && m.peek()->get_allocator() == allocator);
+
+		m.lock()->resize(200);
+		CHECK(live == sizeof(counted_vector) + 200 * sizeof(int));
+
+		dmut<counted, reader_preferring_lock, allocated_storage<counting_allocator<std::byte>>> in_place(std::allocator_arg, allocator, std::make_unique<int>(8), referenced);
+		CHECK(*in_place.peek()->owned == 8);
+		CHECK(live == sizeof(counted_vector) + 200 * sizeof(int) + sizeof(counted));
+	}
+	CHECK(live == 0);
+
+	// inline storage hands the allocator to the data only.
+	{
+		const counting_allocator<int> allocator(&live);
+		dmut<counted_vector> m(std::allocator_arg, allocator, std::size_t(10), 0);
+		CHECK(live == 10 * sizeof(int));
+	}
+	CHECK(live == 0);
+
+	return 0;
+}
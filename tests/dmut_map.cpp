@@ -0,0 +1,46 @@
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "dmut_map.h"
+#include "check.h"
+
+int main()
+{
+	dmut_map<int, std::string, 8> map;
+	CHECK(map.shard_count() == 8);
+
+	map.lock(1)->emplace(1, "one");
+	map.with_write(2, [](auto& shard) { shard.emplace(2, "two"); });
+	CHECK(map.peek(1)->at(1) == "one");
+	CHECK(map.with_read(2, [](const auto& shard) { return shard.at(2); }) == "two");
+
+	// a key always belongs to the same shard.
+	CHECK(&map.shard_of(1) == &map.shard_of(1));
+
+	// writers of other shards are not excluded by a writer holding a shard.
+	int other = 3;
+	while (&map.shard_of(other) == &map.shard_of(1)) ++other;
+	{
+		auto shard = map.lock(1);
+		on_other_thread([&map, other] { CHECK(map.shard_of(other).try_lock().first); CHECK(!map.shard_of(1).try_lock().first); });
+	}
+
+	std::vector<std::thread> threads;
+	for (int i = 0; i < 4; ++i)
+	{
+		threads.emplace_back([&map, i]
+		{
+			for (int key = i * 1000; key < (i + 1) * 1000; ++key) map.lock(key)->emplace(key, std::to_string(key));
+		});
+	}
+
+	for (std::thread& thread : threads) thread.join();
+
+	std::size_t count = 0;
+	map.for_each_shard([&count](const auto& shard) { count += shard.size(); });
+	CHECK(count == 4000);
+	CHECK(map.peek(3999)->at(3999) == "3999");
+
+	return 0;
+}
@@ -0,0 +1,42 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "dmut.h"
+#include "check.h"
+
+int main()
+{
+	dmut<int> m(0);
+
+	std::atomic<bool> waiting{false};
+	std::atomic<bool> woken{false};
+	std::thread waiter([&m, &waiting, &woken]
+	{
+		auto reader = m.peek();
+		waiting.store(true);
+		reader.wait([](const int& value) { return value != 0; });
+		woken.store(true);
+	});
+
+	while (!waiting.load()) std::this_thread::yield();
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+	auto writer = m.lock();
+	*writer = 1;
+
+	// a write queued while the lock is held is run before the writer becomes a reader.
+	on_other_thread([&m] { m.enqueue_write([](int& value) { value += 10; }); });
+	auto reader = writer.downgrade();
+	CHECK(*reader == 11);
+
+	// the waiting reader shares the lock with the downgraded writer.
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+	while (!woken.load() && std::chrono::steady_clock::now() < deadline) std::this_thread::yield();
+	CHECK(woken.load());
+
+	reader.unlock();
+	waiter.join();
+
+	return 0;
+}
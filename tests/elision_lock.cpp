@@ -0,0 +1,76 @@
+#include <thread>
+#include <vector>
+
+#include "dmut.h"
+#include "check.h"
+#include "exclusion.h"
+
+/*
+ *	Writers nest the elided writers locks of two dmuts, ending the inner section
+ *	must leave the outer one running and holding nothing it did not acquire.
+ *	built a second time with DMUT_EMULATE_RTM, so the elision paths run on
+ *	processors without rtm, which is why no thread here ever reads the data.
+ */
+
+typedef dmut<long, elision_lock<>> counter;
+
+constexpr int THREADS = 4;
+constexpr int ITERATIONS = 10000;
+
+int main()
+{
+	// readers and try_lock take the underlying lock, which emulated transactions do not exclude.
+#if !defined(DMUT_EMULATE_RTM)
+	check_exclusion<elision_lock<>>();
+#endif
+
+	counter outer;
+	counter inner;
+
+	{
+		auto outer_writer = outer.lock();
+		{
+			auto inner_writer = inner.lock();
+			++*inner_writer;
+		}
+
+		CHECK(dmut_detail::in_transaction() == dmut_detail::rtm_supported());
+		++*outer_writer;
+	}
+	CHECK(!dmut_detail::in_transaction());
+
+	std::vector<std::thread> threads;
+	for (int i = 0; i < THREADS; ++i)
+	{
+		threads.emplace_back([&outer, &inner]
+		{
+			for (int k = 0; k < ITERATIONS; ++k)
+			{
+				auto outer_writer = outer.lock();
+				++*outer_writer;
+				inner.with_lock([](long& value) { ++value; });
+				++*outer_writer;
+			}
+		});
+	}
+
+	for (std::thread& thread : threads) thread.join();
+
+	constexpr std::uint64_t SECTIONS = THREADS * ITERATIONS + 1;
+	const auto outer_stats = outer.elision_stats();
+	const auto inner_stats = inner.elision_stats();
+
+	// every section either commits or falls back once, and a section nested in
+	// a transaction commits along with it, so the inner lock only counts the
+	// sections nested in an outer section that fell back.
+	CHECK(outer_stats.commits + outer_stats.fallbacks == SECTIONS);
+	CHECK(inner_stats.commits + inner_stats.fallbacks == outer_stats.fallbacks);
+
+	// both underlying locks were released as many times as they were taken.
+	CHECK(outer.try_lock().first);
+	CHECK(inner.try_peek().first);
+	CHECK(*outer.peek() == 2 * static_cast<long>(SECTIONS) - 1);
+	CHECK(*inner.peek() == static_cast<long>(SECTIONS));
+
+	return 0;
+}
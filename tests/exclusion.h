@@ -0,0 +1,65 @@
+#ifndef DMUT_TESTS_EXCLUSION_H
+#define DMUT_TESTS_EXCLUSION_H
+
+#include <thread>
+#include <vector>
+
+#include "dmut.h"
+#include "check.h"
+
+/*
+ *	A lock policy guards a pair of counters that writers increment together,
+ *	readers check they never observe a pair torn by a writer.
+ */
+
+struct pair
+{
+	long first = 0;
+	long second = 0;
+};
+
+template <typename Lock>
+void check_exclusion()
+{
+	constexpr int THREADS = 4;
+	constexpr int ITERATIONS = 20000;
+
+	dmut<pair, Lock> m;
+
+	{
+		auto writer = m.lock();
+		on_other_thread([&m] { CHECK(!m.try_lock().first); CHECK(!m.try_peek().first); });
+	}
+
+	{
+		auto reader = m.peek();
+		on_other_thread([&m] { CHECK(m.try_peek().first); CHECK(!m.try_lock().first); });
+	}
+
+	std::vector<std::thread> threads;
+	for (int i = 0; i < THREADS; ++i)
+	{
+		threads.emplace_back([&m, i]
+		{
+			for (int k = 0; k < ITERATIONS; ++k)
+			{
+				if ((k + i) % 4 == 0)
+				{
+					auto writer = m.lock();
+					++writer->first;
+					++writer->second;
+				}
+				else
+				{
+					auto reader = m.peek();
+					CHECK(reader->first == reader->second);
+				}
+			}
+		});
+	}
+
+	for (std::thread& thread : threads) thread.join();
+	CHECK(m.peek()->first == THREADS * ITERATIONS / 4);
+}
+
+#endif
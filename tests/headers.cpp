@@ -0,0 +1,8 @@
+// every header is compiled on its own, each of them should include what it uses.
+#include "dmut.h"
+#include "dmut_map.h"
+#include "range_dmut.h"
+#include "rcu_dmut.h"
+#include "shm_dmut.h"
+
+int main() { return 0; }
@@ -0,0 +1,57 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <utility>
+
+#include "dmut.h"
+#include "check.h"
+
+/*
+ *	Threads locking, or move assigning, the same pair of dmuts in opposite orders
+ *	all finish, a deadlock shows up as a check failing once the deadline passes.
+ */
+
+constexpr int ITERATIONS = 20000;
+
+template <typename F, typename G>
+void finish_together(F first, G second)
+{
+	std::atomic<int> done{0};
+	std::thread a([&done, first] { for (int i = 0; i < ITERATIONS; ++i) first(); ++done; });
+	std::thread b([&done, second] { for (int i = 0; i < ITERATIONS; ++i) second(); ++done; });
+
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+	while (done.load() != 2 && std::chrono::steady_clock::now() < deadline)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+	// exits while the deadlocked threads are still running.
+	CHECK(done.load() == 2);
+	a.join();
+	b.join();
+}
+
+int main()
+{
+	dmut<long> first(0);
+	dmut<long> second(0);
+
+	finish_together(
+		[&] { auto [a, b] = dmut_lock_all(first, second); ++*a; ++*b; },
+		[&] { auto [b, a] = dmut_lock_all(second, first); ++*a; ++*b; });
+	CHECK(*first.peek() == 2 * ITERATIONS && *second.peek() == 2 * ITERATIONS);
+
+	// a writer and a reader of each dmut.
+	finish_together(
+		[&] { auto [a, b] = dmut_lock_all(first, std::as_const(second)); *a += *b > 0; },
+		[&] { auto [b, a] = dmut_lock_all(second, std::as_const(first)); *b += *a > 0; });
+	CHECK(*first.peek() == 3 * ITERATIONS && *second.peek() == 3 * ITERATIONS);
+
+	// move assignment locks both dmuts, the source and the destination.
+	dmut<long> other(1);
+	finish_together(
+		[&] { first = std::move(other); },
+		[&] { other = std::move(first); });
+	CHECK(*first.peek() == *other.peek());
+
+	return 0;
+}
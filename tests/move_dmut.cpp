@@ -0,0 +1,65 @@
+#include <atomic>
+#include <thread>
+
+#include "dmut.h"
+#include "check.h"
+
+/*
+ *	Inline data is moved in place, so a dmut being moved into is written
+ *	just like it is by a writer, and optimistic readers must see it so.
+ */
+
+struct block
+{
+	long values[64];
+};
+
+block filled(const long value)
+{
+	block result;
+	for (long& element : result.values) element = value;
+	return result;
+}
+
+bool consistent(const block& value)
+{
+	for (const long element : value.values)
+	{
+		if (element != value.values[0]) return false;
+	}
+
+	return true;
+}
+
+int main()
+{
+	dmut<block> m(filled(0));
+	dmut<block> source(filled(1));
+
+	std::atomic<bool> done{false};
+	std::thread reader([&m, &source, &done]
+	{
+		while (!done.load(std::memory_order_relaxed))
+		{
+			CHECK(m.read_optimistic(consistent));
+			CHECK(source.read_optimistic(consistent));
+		}
+	});
+
+	for (long i = 1; i < 1000000; ++i)
+	{
+		if (i % 2 == 0) m = dmut<block>(filled(i));
+		else m = std::move(source);
+	}
+
+	done.store(true);
+	reader.join();
+
+	// the moved dmuts keep working once moved.
+	dmut<block> constructed(std::move(m));
+	CHECK(constructed.peek()->values[63] == 1);
+	CHECK(m.try_lock().first);
+	CHECK(source.try_peek().first);
+
+	return 0;
+}
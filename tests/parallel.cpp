@@ -0,0 +1,55 @@
+#include <atomic>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+#include "dmut.h"
+#include "check.h"
+
+int main()
+{
+	constexpr std::size_t SIZE = 100000;
+
+	for (const unsigned threads : { 1u, 4u })
+	{
+		thread_pool pool(threads);
+		CHECK(pool.size() == threads);
+
+		dmut<std::vector<int>> m(std::vector<int>(SIZE, 0));
+
+		// every element is visited exactly once, by every batch.
+		m.parallel_write([](int& element) { ++element; }, pool);
+		m.parallel_write([](std::vector<int>::iterator begin, std::vector<int>::iterator end) { for (; begin != end; ++begin) *begin += 2; }, pool);
+		for (const int element : *m.peek()) CHECK(element == 3);
+
+		std::atomic<long> sum{0};
+		m.parallel_read([&sum](const int& element) { sum.fetch_add(element, std::memory_order_relaxed); }, pool);
+		CHECK(sum.load() == 3 * static_cast<long>(SIZE));
+
+		// the indices of a batch are split into disjoint chunks covering all of them.
+		std::vector<std::atomic<int>> visits(SIZE);
+		pool.run(SIZE, [&visits](const std::size_t begin, const std::size_t end)
+		{
+			for (std::size_t i = begin; i < end; ++i) visits[i].fetch_add(1, std::memory_order_relaxed);
+		});
+		for (const std::atomic<int>& count : visits) CHECK(count.load() == 1);
+
+		// an exception thrown by a chunk reaches the caller, and the lock is released.
+		bool threw = false;
+		try { m.parallel_write([](int& element) { if (element == 3) throw std::runtime_error("chunk failed"); }, pool); }
+		catch (const std::runtime_error&) { threw = true; }
+		CHECK(threw);
+		CHECK(m.try_lock().first);
+
+		threw = false;
+		try { m.parallel_read([](const int&) { throw std::logic_error("read failed"); }, pool); }
+		catch (const std::logic_error&) { threw = true; }
+		CHECK(threw);
+
+		// the pool runs batches again once one failed.
+		m.parallel_write([](int& element) { element = 0; }, pool);
+		CHECK(std::accumulate(m.peek()->begin(), m.peek()->end(), 0) == 0);
+	}
+
+	return 0;
+}
@@ -0,0 +1,114 @@
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include "dmut.h"
+#include "exclusion.h"
+
+typedef dmut<std::string, priority_lock<>> ranked;
+
+/**
+ * \brief	queues the requests one at a time while the lock is held, each appending its mark
+ *			to the data once granted, and returns the order they were served in.
+ */
+template <typename M, typename Request>
+std::string served(M& m, const std::vector<Request>& requests)
+{
+	std::vector<std::thread> waiters;
+	{
+		auto holder = m.lock();
+		holder->clear();
+
+		for (const Request& request : requests)
+		{
+			waiters.emplace_back([&m, request] { request(m); });
+			std::this_thread::sleep_for(std::chrono::milliseconds(30));
+		}
+	}
+
+	for (std::thread& waiter : waiters) waiter.join();
+	return *m.peek();
+}
+
+int main()
+{
+	check_exclusion<priority_lock<>>();
+	check_exclusion<priority_lock<true>>();
+
+	ranked m;
+	typedef void (*request)(ranked&);
+
+	// waiters of a higher priority are granted the lock first, equal ones in the order they came.
+	const std::vector<request> by_priority{
+		[](ranked& m) { *m.lock(1) += "a"; },
+		[](ranked& m) { *m.lock(5) += "b"; },
+		[](ranked& m) { *m.lock(1) += "c"; },
+		[](ranked& m) { *m.lock(3) += "d"; },
+	};
+	CHECK(served(m, by_priority) == "bdac");
+
+	// and the waiters of equal priority are granted the lock by the soonest deadline.
+	const std::vector<request> by_deadline{
+		[](ranked& m) { *m.lock_until(std::chrono::steady_clock::now() + std::chrono::hours(2)) += "a"; },
+		[](ranked& m) { *m.lock_until(std::chrono::steady_clock::now() + std::chrono::hours(1)) += "b"; },
+		[](ranked& m) { *m.lock(1) += "c"; },
+	};
+	CHECK(served(m, by_deadline) == "cba");
+
+	// a timed acquire gives up once its deadline passes and leaves the queue.
+	{
+		auto holder = m.lock();
+		on_other_thread([&m]
+		{
+			CHECK(!m.try_lock_for(std::chrono::milliseconds(30)));
+			CHECK(!m.try_peek_for(std::chrono::milliseconds(30)));
+		});
+	}
+	CHECK(m.try_lock().first);
+
+	// a writer holding the lock is raised to the scheduling priority of a realtime waiter,
+	// which requires the privilege to use realtime priorities.
+	dmut<int, priority_lock<true>> inheriting(0);
+	int holder_priority = -1;
+	int boosted_priority = -1;
+	std::thread holder([&inheriting, &holder_priority, &boosted_priority]
+	{
+		const sched_param low{ 1 };
+		if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &low) != 0) return;
+
+		auto writer = inheriting.lock();
+		std::thread waiter([&inheriting]
+		{
+			const sched_param high{ 10 };
+			pthread_setschedparam(pthread_self(), SCHED_FIFO, &high);
+			++*inheriting.lock();
+		});
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		int policy = 0;
+		sched_param current{};
+		pthread_getschedparam(pthread_self(), &policy, &current);
+		boosted_priority = current.sched_priority;
+
+		writer.unlock();
+		waiter.join();
+
+		pthread_getschedparam(pthread_self(), &policy, &current);
+		holder_priority = current.sched_priority;
+	});
+	holder.join();
+
+	if (holder_priority == -1) std::printf("priority inheritance not checked, realtime priorities are not permitted\n");
+	else
+	{
+		CHECK(boosted_priority == 10);
+		CHECK(holder_priority == 1);
+		CHECK(*inheriting.peek() == 1);
+	}
+
+	return 0;
+}
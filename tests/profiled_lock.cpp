@@ -0,0 +1,75 @@
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "dmut.h"
+#include "check.h"
+#include "exclusion.h"
+
+typedef dmut<int, profiled_lock<>> profiled;
+
+bool registered(const std::string& name)
+{
+	bool found = false;
+	dmut_registry::global().for_each([&](const std::string& entry, const lock_profile&) { found = found || entry == name; });
+	return found;
+}
+
+int main()
+{
+	check_exclusion<profiled_lock<>>();
+
+	{
+		profiled m(0);
+		auto writer = m.lock();
+
+		// failed try acquires are contended, but acquire nothing.
+		on_other_thread([&m] { CHECK(!m.try_lock().first); CHECK(!m.try_peek().first); });
+		lock_profile profile = m.profile();
+		CHECK(profile.write.acquires == 1 && profile.write.contended == 1);
+		CHECK(profile.read.acquires == 0 && profile.read.contended == 1);
+
+		// a writer waiting for the lock is contended once it gets it.
+		std::thread waiter([&m] { ++*m.lock(); });
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		writer.unlock();
+		waiter.join();
+
+		profile = m.profile();
+		CHECK(profile.write.acquires == 2 && profile.write.contended == 2);
+
+		// the readers holding the lock together are counted.
+		{
+			auto first = m.peek();
+			auto second = m.peek();
+			auto third = m.peek();
+			CHECK(*first + *second + *third == 3);
+		}
+		m.peek();
+
+		profile = m.profile();
+		CHECK(profile.read.acquires == 4 && profile.read.contended == 1);
+		CHECK(profile.max_readers == 3);
+	}
+
+	// a registered dmut is dumped under its name until it is destroyed.
+	{
+		profiled m(0);
+		m.profile_as("profiled_lock_test");
+		++*m.lock();
+		CHECK(registered("profiled_lock_test"));
+
+		std::ostringstream out;
+		dmut_registry::global().dump(out);
+		CHECK(out.str().find("profiled_lock_test write acquires=1 contended=0") != std::string::npos);
+		CHECK(out.str().find("profiled_lock_test max_readers=0") != std::string::npos);
+
+		m.profile_as("profiled_lock_renamed");
+		CHECK(!registered("profiled_lock_test"));
+		CHECK(registered("profiled_lock_renamed"));
+	}
+	CHECK(!registered("profiled_lock_renamed"));
+
+	return 0;
+}
@@ -0,0 +1,51 @@
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "dmut.h"
+#include "check.h"
+
+typedef dmut<std::string, reader_preferring_lock, pointer_storage> published;
+
+// only the readers of data publish may replace hold more than the owner.
+static_assert(sizeof(dmut<std::string>::read_lock) == sizeof(void*));
+static_assert(sizeof(published::write_lock) == sizeof(void*));
+
+int main()
+{
+	published m(std::in_place, "first");
+
+	// a reader keeps the value it found while newer values are published.
+	auto reader = m.peek();
+	const std::string *found = &*reader;
+	m.publish(std::make_unique<std::string>("second"));
+	CHECK(&*reader == found);
+	CHECK(*reader == "first");
+	CHECK(*m.peek() == "second");
+
+	// and so does the reader it is moved to.
+	published::read_lock moved = std::move(reader);
+	m.publish(std::make_unique<std::string>("third"));
+	CHECK(&*moved == found);
+	CHECK(moved->size() == 5);
+	moved.unlock();
+
+	// once the readers left, the next writer deletes the replaced values.
+	m.lock()->append("!");
+	CHECK(*m.peek() == "third!");
+
+	// a reader waiting releases the lock, it finds the data published meanwhile.
+	reader = m.peek();
+	std::thread writer([&m]
+	{
+		m.publish(std::make_unique<std::string>("fourth"));
+		m.lock()->assign("ready");
+	});
+
+	reader.wait([](const std::string& value) { return value == "ready"; });
+	CHECK(*reader == "ready");
+	reader.unlock();
+	writer.join();
+
+	return 0;
+}
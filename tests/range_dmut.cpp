@@ -0,0 +1,98 @@
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "range_dmut.h"
+#include "check.h"
+
+template <typename Ranges, bool DISJOINT_STRIPES = true>
+void check_ranges()
+{
+	range_dmut<std::vector<int>, Ranges> m(std::vector<int>(1000, 0));
+	CHECK(m.size() == 1000);
+
+	{
+		auto range = m.lock_range(0, 10);
+		CHECK(range.size() == 10);
+		range[0] = 1;
+
+		// a range far enough from the locked one is available to other threads.
+		if constexpr (DISJOINT_STRIPES) on_other_thread([&m] { auto other = m.lock_range(900, 910); other[0] = 2; });
+	}
+
+	CHECK(m.peek_range(900, 901)[0] == (DISJOINT_STRIPES ? 2 : 0));
+
+	CHECK(m.peek_range(0, 1)[0] == 1);
+
+	bool threw = false;
+	try
+	{
+		auto range = m.lock_range(990, 1001);
+	}
+	catch (const std::out_of_range&)
+	{
+		threw = true;
+	}
+	CHECK(threw);
+
+	// writers of disjoint ranges all count their own part.
+	std::vector<std::thread> threads;
+	for (int i = 0; i < 4; ++i)
+	{
+		threads.emplace_back([&m, i]
+		{
+			for (int k = 0; k < 200; ++k)
+			{
+				auto range = m.lock_range(i * 250, (i + 1) * 250);
+				for (int& value : range) ++value;
+			}
+		});
+	}
+
+	for (std::thread& thread : threads) thread.join();
+
+	auto whole = m.peek();
+	CHECK(whole[1] == 200 && whole[999] == 200 && whole[0] == 201);
+	whole.unlock();
+
+	// a pending lock of the whole container keeps new range locks out.
+	{
+		auto range = m.peek_range(0, 10);
+		std::atomic<int> order{0};
+		int writer_order = 0, reader_order = 0;
+
+		std::thread writer([&m, &order, &writer_order] { auto whole = m.lock(); writer_order = ++order; });
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		std::thread reader([&m, &order, &reader_order] { auto other = m.peek_range(500, 510); reader_order = ++order; });
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+		CHECK(order.load() == 0);
+		range.unlock();
+		writer.join();
+		reader.join();
+		CHECK(writer_order == 1 && reader_order == 2);
+	}
+
+	// the container can be resized once no range is held.
+	m.lock()->resize(10);
+	CHECK(m.size() == 10);
+}
+
+int main()
+{
+	check_ranges<striped_ranges<>>();
+	check_ranges<striped_ranges<1>, false>();
+	check_ranges<interval_ranges>();
+
+	// ranges ending where another range begins do not overlap.
+	range_dmut<std::vector<int>, interval_ranges> m(std::vector<int>(100, 0));
+	{
+		auto range = m.lock_range(10, 20);
+		on_other_thread([&m] { auto other = m.lock_range(20, 30); other[0] = 1; });
+		CHECK(m.size() == 100);
+	}
+
+	return 0;
+}
@@ -0,0 +1,51 @@
+#include <thread>
+#include <vector>
+
+#include "rcu_dmut.h"
+#include "check.h"
+
+int main()
+{
+	rcu_dmut<std::vector<int>> m(std::vector<int>{ 1, 2, 3 });
+
+	// a snapshot stays the same while writers publish newer versions.
+	auto snapshot = m.peek();
+	m.lock()->push_back(4);
+	CHECK(snapshot->size() == 3);
+	CHECK(m.peek()->size() == 4);
+
+	// readers never wait for a writer.
+	{
+		auto writer = m.lock();
+		writer->push_back(5);
+		on_other_thread([&m] { CHECK(m.try_peek().first); CHECK(m.peek()->size() == 4); CHECK(!m.try_lock().first); });
+	}
+	CHECK(m.peek()->size() == 5);
+
+	m.replace(std::vector<int>{ 7 });
+	CHECK(m.with_peek([](const std::vector<int>& v) { return v.front(); }) == 7);
+	CHECK(snapshot->size() == 3);
+	snapshot.unlock();
+
+	std::vector<std::thread> threads;
+	for (int i = 0; i < 4; ++i)
+	{
+		threads.emplace_back([&m, i]
+		{
+			for (int k = 0; k < 500; ++k)
+			{
+				if (i == 0) m.with_lock([](std::vector<int>& v) { v.push_back(v.back() + 1); });
+				else
+				{
+					auto reader = m.peek();
+					CHECK(reader->back() == reader->front() + static_cast<int>(reader->size()) - 1);
+				}
+			}
+		});
+	}
+
+	for (std::thread& thread : threads) thread.join();
+	CHECK(m.peek()->size() == 501);
+
+	return 0;
+}
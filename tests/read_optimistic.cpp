@@ -0,0 +1,67 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "dmut.h"
+#include "check.h"
+
+struct block
+{
+	long values[32];
+};
+
+bool consistent(const block& value)
+{
+	for (const long element : value.values)
+	{
+		if (element != value.values[0]) return false;
+	}
+
+	return true;
+}
+
+int main()
+{
+	dmut<block> m(block{});
+
+	// every copy accepted while a writer keeps writing is consistent.
+	std::atomic<bool> done{false};
+	std::thread writer([&m, &done]
+	{
+		for (long i = 1; i <= 200000; ++i)
+		{
+			auto lock = m.lock();
+			for (long& element : lock->values) element = i;
+		}
+
+		done.store(true);
+	});
+
+	long last = 0;
+	while (!done.load())
+	{
+		const long seen = m.read_optimistic([](const block& value) { CHECK(consistent(value)); return value.values[0]; });
+		CHECK(seen >= last);
+		last = seen;
+	}
+	writer.join();
+	CHECK(m.read_optimistic([](const block& value) { return value.values[31]; }) == 200000);
+
+	// while a writer holds the lock the read falls back to a readers lock, and waits for the writer.
+	{
+		auto lock = m.lock();
+		std::thread reader([&m] { CHECK(m.read_optimistic([](const block& value) { return value.values[0]; }) == -1); });
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		for (long& element : lock->values) element = -1;
+		lock.unlock();
+		reader.join();
+	}
+
+	// data replaced by publish is always read under a readers lock.
+	dmut<block, reader_preferring_lock, pointer_storage> published(std::in_place);
+	published.lock()->values[0] = 7;
+	CHECK(published.read_optimistic([](const block& value) { return value.values[0]; }) == 7);
+
+	return 0;
+}
@@ -0,0 +1,49 @@
+#include <system_error>
+
+#include "dmut.h"
+#include "exclusion.h"
+
+typedef dmut<pair, reentrant_lock<>> reentrant;
+
+int main()
+{
+	check_exclusion<reentrant_lock<>>();
+
+	reentrant m;
+
+	// a thread enters the locks it holds again, and holds them until it left them all.
+	{
+		auto writer = m.lock();
+		auto nested = m.lock();
+		auto reader = m.peek();
+		++nested->first;
+		CHECK(reader->first == 1);
+
+		nested.unlock();
+		writer.unlock();
+		on_other_thread([&m] { CHECK(!m.try_peek().first); });
+
+		// the underlying lock is still held exclusively by the reader nested in the writer.
+		auto again = m.lock();
+		++again->second;
+	}
+	on_other_thread([&m] { CHECK(m.try_lock().first); });
+
+	// a reader cannot become a writer, which would deadlock with another reader doing the same.
+	{
+		auto reader = m.peek();
+		CHECK(!m.try_lock().first);
+
+		bool threw = false;
+		try { m.lock(); }
+		catch (const std::system_error& error) { threw = error.code() == std::errc::resource_deadlock_would_occur; }
+		CHECK(threw);
+
+		auto nested = m.peek();
+		CHECK(nested->second == 1);
+		on_other_thread([&m] { CHECK(m.try_peek().first); CHECK(!m.try_lock().first); });
+	}
+	CHECK(m.try_lock().first);
+
+	return 0;
+}
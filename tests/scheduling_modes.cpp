@@ -0,0 +1,38 @@
+#include <chrono>
+#include <thread>
+
+#include "dmut.h"
+#include "check.h"
+#include "exclusion.h"
+
+/**
+ * \brief	checks whether new readers get in while a writer waits for the readers holding the lock.
+ */
+template <typename Lock>
+void check_waiting_writer(const bool readers_get_in)
+{
+	dmut<pair, Lock> m;
+	auto reader = m.peek();
+
+	std::thread writer([&m] { ++m.lock()->first; });
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+	on_other_thread([&m, readers_get_in] { CHECK(m.try_peek().first == readers_get_in); });
+	reader.unlock();
+	writer.join();
+
+	CHECK(m.peek()->first == 1);
+}
+
+int main()
+{
+	check_exclusion<reader_preferring_lock>();
+	check_exclusion<writer_preferring_lock>();
+	check_exclusion<phase_fair_lock>();
+
+	check_waiting_writer<reader_preferring_lock>(true);
+	check_waiting_writer<writer_preferring_lock>(false);
+	check_waiting_writer<phase_fair_lock>(false);
+
+	return 0;
+}
@@ -0,0 +1,197 @@
+#include <chrono>
+#include <csignal>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "shm_dmut.h"
+#include "check.h"
+
+struct table
+{
+	long counter;
+	long values[1000];
+};
+
+// dies while being constructed by the creator of a shm_dmut.
+struct dying
+{
+	long value;
+
+	explicit dying(long value = 0) : value(value) { kill(getpid(), SIGKILL); }
+};
+
+template <typename M>
+bool open_throws(const char *name)
+{
+	try { M m(name); }
+	catch (const std::runtime_error&) { return true; }
+	return false;
+}
+
+/**
+ * \brief	runs fn in a child process with a shm_dmut of its own and waits for the child,
+ *			the child exits when fn returns, or dies if fn kills it.
+ */
+template <typename F>
+void in_child(const char *name, F fn)
+{
+	const pid_t child = fork();
+	if (child == 0)
+	{
+		shm_dmut<table> m(name);
+		fn(m);
+		_exit(0);
+	}
+
+	int status = 0;
+	waitpid(child, &status, 0);
+}
+
+int main()
+{
+	const char *name = "/dmut_test_shm_dmut";
+	shm_dmut<table>::remove(name);
+
+	{
+		shm_dmut<table> m(name, table{});
+
+		for (int p = 0; p < 4; ++p)
+		{
+			if (fork() != 0) continue;
+
+			shm_dmut<table> child(name);
+			for (int i = 0; i < 4000; ++i)
+			{
+				if (i % 4 == 0)
+				{
+					auto writer = child.lock();
+					++writer->counter;
+					++writer->values[i % 1000];
+				}
+				else CHECK(child.peek()->counter >= 0);
+			}
+			_exit(0);
+		}
+
+		for (int p = 0; p < 4; ++p) wait(nullptr);
+		CHECK(m.peek()->counter == 4000);
+		CHECK(!m.abandoned());
+
+		// a writer dying while holding the lock leaves the data to the next reader.
+		in_child(name, [](shm_dmut<table>& child) { auto writer = child.lock(); writer->counter = -1; kill(getpid(), SIGKILL); });
+		CHECK(m.peek()->counter == -1);
+		CHECK(m.abandoned());
+		{
+			auto writer = m.lock();
+			writer->counter = 0;
+			m.mark_consistent();
+		}
+		CHECK(!m.abandoned());
+
+		// and to the next writer.
+		in_child(name, [](shm_dmut<table>& child) { auto writer = child.lock(); kill(getpid(), SIGKILL); });
+		CHECK(m.try_lock().first);
+		CHECK(m.abandoned());
+		m.mark_consistent();
+
+		// the readers of a dead process are dropped.
+		in_child(name, [](shm_dmut<table>& child) { auto reader = child.peek(); kill(getpid(), SIGKILL); });
+		CHECK(m.try_lock().first);
+		CHECK(!m.abandoned());
+
+		// and so are the readers a parked writer waits for.
+		int ready[2];
+		CHECK(pipe(ready) == 0);
+		const pid_t reader = fork();
+		if (reader == 0)
+		{
+			shm_dmut<table> child(name);
+			auto held = child.peek();
+			CHECK(write(ready[1], "r", 1) == 1);
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+			kill(getpid(), SIGKILL);
+		}
+
+		char entered;
+		CHECK(read(ready[0], &entered, 1) == 1);
+		CHECK(!m.try_lock().first);
+
+		// a dead process is alive until reaped.
+		std::thread reaper([reader] { waitpid(reader, nullptr, 0); });
+		++m.lock()->counter;
+		reaper.join();
+		close(ready[0]);
+		close(ready[1]);
+
+		// a writer parked waiting for a reader of its own process is woken once the reader leaves.
+		{
+			auto held = m.peek();
+			std::thread writer([&m] { --m.lock()->counter; });
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+			CHECK(!m.try_peek().first);
+			held.unlock();
+			writer.join();
+		}
+		CHECK(m.try_lock().first);
+
+		// a lock is owned by the process, any of its threads may release it.
+		auto moved = m.lock();
+		on_other_thread([&m, writer = std::move(moved)]() mutable { CHECK(!m.try_peek().first); writer.unlock(); });
+		CHECK(m.try_lock().first);
+
+		std::vector<std::thread> threads;
+		for (int i = 0; i < 4; ++i)
+		{
+			threads.emplace_back([&m]
+			{
+				for (int k = 0; k < 8000; ++k)
+				{
+					if (k % 8 == 0) ++m.lock()->counter;
+					else CHECK(m.try_peek().first || m.peek()->counter > 0);
+				}
+			});
+		}
+
+		for (std::thread& thread : threads) thread.join();
+		CHECK(m.peek()->counter == 4000);
+
+		{
+			auto reader = m.peek();
+			on_other_thread([&m] { CHECK(m.try_peek().first); CHECK(!m.try_lock().first); });
+		}
+
+		shm_dmut<table> again(name);
+		CHECK(again.peek()->counter == 4000);
+
+		bool threw = false;
+		try { shm_dmut<int> wrong(name); }
+		catch (const std::runtime_error&) { threw = true; }
+		CHECK(threw);
+	}
+
+	CHECK(shm_dmut<table>::remove(name));
+
+	// an object whose creator died before sizing it, or before constructing the data, cannot be opened.
+	const int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+	CHECK(fd != -1);
+	close(fd);
+	CHECK(open_throws<shm_dmut<table>>(name));
+	CHECK(shm_dmut<table>::remove(name));
+
+	if (fork() == 0)
+	{
+		shm_dmut<dying> creator(name, 0);
+		_exit(0);
+	}
+	wait(nullptr);
+	CHECK(open_throws<shm_dmut<dying>>(name));
+	CHECK(shm_dmut<dying>::remove(name));
+
+	return 0;
+}
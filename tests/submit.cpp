@@ -0,0 +1,71 @@
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "dmut.h"
+#include "check.h"
+
+struct journal
+{
+	std::vector<int> entries;
+	std::vector<std::thread::id> runners;
+};
+
+int main()
+{
+	constexpr int SUBMITTERS = 4;
+	dmut<journal> m;
+
+	// operations submitted while the lock is held are run in a batch by its holder.
+	int results[SUBMITTERS] = {};
+	bool threw[SUBMITTERS] = {};
+	{
+		auto holder = m.lock();
+
+		std::vector<std::thread> submitters;
+		for (int i = 0; i < SUBMITTERS; ++i)
+		{
+			submitters.emplace_back([&m, &results, &threw, i]
+			{
+				try
+				{
+					results[i] = m.submit([i](journal& value)
+					{
+						value.entries.push_back(i);
+						value.runners.push_back(std::this_thread::get_id());
+						if (i == 2) throw std::runtime_error("submitted operation failed");
+
+						return i * 10;
+					});
+				}
+				catch (const std::runtime_error&) { threw[i] = true; }
+			});
+		}
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		CHECK(holder->entries.empty());
+		holder.unlock();
+
+		for (std::thread& submitter : submitters) submitter.join();
+	}
+
+	auto value = m.peek();
+	CHECK(value->entries.size() == SUBMITTERS);
+	for (const std::thread::id runner : value->runners) CHECK(runner == std::this_thread::get_id());
+
+	// every submitter gets the result of its own operation, and only the failing one gets the exception.
+	for (int i = 0; i < SUBMITTERS; ++i)
+	{
+		CHECK(threw[i] == (i == 2));
+		if (i != 2) CHECK(results[i] == i * 10);
+	}
+	value.unlock();
+
+	// without a lock holder the submitter runs the operation itself.
+	CHECK(m.submit([](journal& value) { return static_cast<int>(value.entries.size()); }) == SUBMITTERS);
+	m.submit([](journal& value) { value.entries.clear(); });
+	CHECK(m.peek()->entries.empty());
+
+	return 0;
+}
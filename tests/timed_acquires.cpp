@@ -0,0 +1,69 @@
+#include <chrono>
+#include <thread>
+
+#include "dmut.h"
+#include "check.h"
+
+/*
+ *	The timed acquires of every lock supporting them give up once their timeout
+ *	expires while the lock is held, and succeed once it is released in time.
+ *	phase_fair_lock only times its readers, a writer ticket cannot be handed back.
+ */
+
+using namespace std::chrono_literals;
+
+template <typename Lock>
+constexpr bool TIMED_WRITERS = requires (Lock& lock, const dmut_detail::deadline& until) { lock.try_lock_until(until); };
+
+template <typename Lock>
+void check_timed()
+{
+	dmut<int, Lock> m(0);
+
+	{
+		auto writer = m.lock();
+		on_other_thread([&m]
+		{
+			const auto start = std::chrono::steady_clock::now();
+			CHECK(!m.try_peek_for(20ms));
+			if constexpr (TIMED_WRITERS<Lock>) CHECK(!m.try_lock_for(20ms));
+			CHECK(std::chrono::steady_clock::now() - start >= (TIMED_WRITERS<Lock> ? 40ms : 20ms));
+			CHECK(!m.try_peek_until(std::chrono::steady_clock::now()));
+		});
+
+		std::thread waiter([&m] { auto reader = m.try_peek_for(5s); CHECK(reader && **reader == 1); });
+		std::this_thread::sleep_for(20ms);
+		++*writer;
+		writer.unlock();
+		waiter.join();
+	}
+
+	if constexpr (TIMED_WRITERS<Lock>)
+	{
+		auto reader = m.peek();
+		on_other_thread([&m] { CHECK(!m.try_lock_for(20ms)); });
+
+		std::thread waiter([&m] { auto writer = m.try_lock_for(5s); CHECK(writer); ++**writer; });
+		std::this_thread::sleep_for(20ms);
+		reader.unlock();
+		waiter.join();
+		CHECK(*m.peek() == 2);
+	}
+
+	// nothing is left holding or waiting for the lock.
+	CHECK(m.try_lock().first);
+}
+
+int main()
+{
+	check_timed<reader_preferring_lock>();
+	check_timed<writer_preferring_lock>();
+	check_timed<phase_fair_lock>();
+	check_timed<big_reader_lock<>>();
+	check_timed<elision_lock<>>();
+	check_timed<priority_lock<>>();
+	check_timed<profiled_lock<>>();
+	check_timed<reentrant_lock<>>();
+
+	return 0;
+}
@@ -0,0 +1,62 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "dmut.h"
+#include "check.h"
+
+/*
+ *	An upgradeable reader shares the lock with plain readers but not with another
+ *	upgradeable reader or a writer, and its promotion waits for the readers inside.
+ */
+
+using namespace std::chrono_literals;
+
+template <typename Lock>
+void check_upgrade()
+{
+	dmut<int, Lock> m(0);
+
+	auto upgradeable = m.peek_upgradeable();
+	on_other_thread([&m]
+	{
+		auto reader = m.try_peek();
+		CHECK(reader.first && *reader.second == 0);
+		CHECK(!m.try_peek_upgradeable().first);
+		CHECK(!m.try_lock().first);
+	});
+
+	auto reader = m.peek();
+	std::atomic<bool> promoted{false};
+	std::thread upgrader([&m, &promoted, upgradeable = std::move(upgradeable)]() mutable
+	{
+		auto writer = upgradeable.upgrade();
+		promoted.store(true);
+		++*writer;
+	});
+
+	// the promotion keeps the new readers out while the ones inside read on.
+	std::this_thread::sleep_for(20ms);
+	CHECK(!promoted.load());
+	on_other_thread([&m] { CHECK(!m.try_peek().first); });
+	CHECK(*reader == 0);
+
+	reader.unlock();
+	upgrader.join();
+	CHECK(promoted.load());
+	CHECK(*m.peek() == 1);
+
+	// releasing an upgradeable lock lets the next one in.
+	m.peek_upgradeable().unlock();
+	CHECK(m.try_peek_upgradeable().first);
+	CHECK(m.try_lock().first);
+}
+
+int main()
+{
+	check_upgrade<reader_preferring_lock>();
+	check_upgrade<writer_preferring_lock>();
+	check_upgrade<profiled_lock<>>();
+
+	return 0;
+}
@@ -0,0 +1,63 @@
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include "dmut.h"
+#include "check.h"
+
+/*
+ *	with_lock and with_peek hold the lock for exactly as long as their closure
+ *	runs, whether it returns a value, returns nothing or throws.
+ */
+
+template <typename Lock>
+void check_with_lock()
+{
+	dmut<std::string, Lock> m("data");
+
+	// the result of the closure is returned as is, references included.
+	const std::size_t size = m.with_lock([&m](std::string& value)
+	{
+		on_other_thread([&m] { CHECK(!m.try_peek().first); });
+		value += "!";
+		return value.size();
+	});
+	CHECK(size == 5);
+	CHECK(*m.peek() == "data!");
+
+	static_assert(std::is_same<decltype(m.with_peek([](const std::string& value) -> const std::string& { return value; })), const std::string&>::value);
+	CHECK(m.with_peek([&m](const std::string& value)
+	{
+		on_other_thread([&m] { CHECK(m.try_peek().first); CHECK(!m.try_lock().first); });
+		return value;
+	}) == "data!");
+
+	// a closure returning nothing.
+	m.with_lock([](std::string& value) { value.clear(); });
+	static_assert(std::is_void<decltype(m.with_peek([](const std::string&) {}))>::value);
+	m.with_peek([](const std::string& value) { CHECK(value.empty()); });
+
+	// a closure throwing releases the lock on its way out.
+	bool threw = false;
+	try { m.with_lock([](std::string& value) { value = "thrown"; throw std::runtime_error("writer"); }); }
+	catch (const std::runtime_error&) { threw = true; }
+	CHECK(threw);
+	CHECK(m.try_lock().first);
+	CHECK(*m.peek() == "thrown");
+
+	threw = false;
+	try { m.with_peek([](const std::string&) -> int { throw std::logic_error("reader"); }); }
+	catch (const std::logic_error&) { threw = true; }
+	CHECK(threw);
+	CHECK(m.try_lock().first);
+}
+
+int main()
+{
+	check_with_lock<reader_preferring_lock>();
+	check_with_lock<writer_preferring_lock>();
+	check_with_lock<phase_fair_lock>();
+	check_with_lock<profiled_lock<>>();
+
+	return 0;
+}
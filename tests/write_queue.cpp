@@ -0,0 +1,70 @@
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "dmut.h"
+#include "check.h"
+
+bool eventually(dmut<std::string>& m, const std::string& expected)
+{
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+	while (m.with_peek([&expected](const std::string& value) { return value != expected; }))
+	{
+		if (std::chrono::steady_clock::now() >= deadline) return false;
+		std::this_thread::yield();
+	}
+
+	return true;
+}
+
+int main()
+{
+	dmut<std::string> m;
+
+	// queued writes are left for the next writer, which runs them in the order they were queued.
+	m.enqueue_write([](std::string& value) { value += "a"; });
+	m.enqueue_write([](std::string& value) { value += "b"; });
+	CHECK(m.peek()->empty());
+	m.lock().unlock();
+	CHECK(*m.peek() == "ab");
+
+	// and the writer holding the lock runs the writes queued meanwhile.
+	{
+		auto writer = m.lock();
+		on_other_thread([&m] { m.enqueue_write([](std::string& value) { value += "c"; }); });
+		*writer += "-";
+	}
+	CHECK(*m.peek() == "ab-c");
+
+	// only the latest write of a key is run, in its place in the queue.
+	m.enqueue_write(1, [](std::string& value) { value += "1"; });
+	m.enqueue_write(2, [](std::string& value) { value += "2"; });
+	m.enqueue_write([](std::string& value) { value += "x"; });
+	m.enqueue_write(1, [](std::string& value) { value += "one"; });
+	m.flush_writes();
+	CHECK(*m.peek() == "ab-c2xone");
+
+	// a drainer runs the queued writes on its own.
+	m.start_write_drainer();
+	m.enqueue_write([](std::string& value) { value = "drained"; });
+	CHECK(eventually(m, "drained"));
+
+	// and once stopped the writes wait for the next writer again.
+	m.stop_write_drainer();
+	m.enqueue_write([](std::string& value) { value += "!"; });
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	CHECK(*m.peek() == "drained");
+	m.flush_writes();
+	CHECK(*m.peek() == "drained!");
+
+	// a drainer still running is stopped by the destructor, which runs what is left.
+	{
+		dmut<std::string> other;
+		other.start_write_drainer();
+		other.enqueue_write([](std::string& value) { value = "done"; });
+		CHECK(eventually(other, "done"));
+		other.enqueue_write([](std::string& value) { value += "?"; });
+	}
+
+	return 0;
+}